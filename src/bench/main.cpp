@@ -0,0 +1,400 @@
+// Compare the priority queue and table policies of a_star on maps.
+//
+// For each map, a set of random start-goal pairs is searched once with every
+// policy. Two kinds of search are measured: plain A* with unitary step cost,
+// with either hash or grid tables, with jump point search, with the ALT
+// heuristic or through a cluster hierarchy (HPA*), and the windowed space-time search with predicted_cost used for
+// rejoining paths in LRA* and WHCA*. Replanning as LRA* does it is measured
+// too: agents walk towards their goals with random tiles next to them blocked,
+// finding a new path after each step either from scratch or with D* Lite.
+
+#include "a_star.hpp"
+#include "d_star_lite.hpp"
+#include "hpa.hpp"
+#include "jps.hpp"
+#include "landmarks.hpp"
+#include "predictor.hpp"
+#include "world.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct result {
+  double time_ms = 0.0;
+  unsigned long expanded = 0;
+  unsigned long path_length = 0;
+};
+
+template <template <typename> class Queue>
+using plain_search = a_star<
+  position, position_successors, always_passable,
+  manhattan_distance_heuristic, unitary_step_cost, space_coordinate<>,
+  position_distance_storage, always_close<position>, coord_open_set,
+  Queue
+>;
+
+template <template <typename> class Queue>
+using plain_grid_search = a_star<
+  position, position_successors, always_passable,
+  manhattan_distance_heuristic, unitary_step_cost, space_coordinate<>,
+  grid_distance_storage, always_close<position>, grid_open_set,
+  Queue, grid_closed_set
+>;
+
+struct static_passable {
+  bool operator () (position, world const&) const { return true; }
+};
+
+template <template <typename> class Queue>
+using plain_jps_search = a_star<
+  position, jps_successors<static_passable>, always_passable,
+  manhattan_distance_heuristic, manhattan_step_cost, space_coordinate<>,
+  no_distance_storage, always_close<position>, grid_open_set,
+  Queue, grid_closed_set
+>;
+
+struct not_blocked {
+  std::vector<position> const* blocked;
+
+  bool operator () (position p, world const&) const {
+    return std::find(blocked->begin(), blocked->end(), p) == blocked->end();
+  }
+};
+
+using replan_jps_search = a_star<
+  position, jps_successors<not_blocked>, always_passable,
+  manhattan_distance_heuristic, manhattan_step_cost, space_coordinate<>,
+  no_distance_storage, always_close<position>, grid_open_set,
+  radix_queue, grid_closed_set
+>;
+
+using alt_search = a_star<
+  position, position_successors, always_passable,
+  alt_heuristic, unitary_step_cost, space_coordinate<>,
+  no_distance_storage, always_close<position>, grid_open_set,
+  radix_queue, grid_closed_set
+>;
+
+template <template <typename> class Queue>
+using space_time_search = a_star<
+  position, position_successors, always_passable,
+  manhattan_distance_heuristic, predicted_cost, space_time_coordinate,
+  position_distance_storage, always_close<position_time>, coord_open_set,
+  Queue
+>;
+
+using pairs_type = std::vector<std::tuple<position, position>>;
+
+template <typename F>
+result
+measure(pairs_type const& pairs, F search) {
+  result r;
+  auto const start = std::chrono::steady_clock::now();
+  for (auto const& pair : pairs)
+    search(std::get<0>(pair), std::get<1>(pair), r);
+  r.time_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start
+  ).count();
+  return r;
+}
+
+template <typename Search>
+result
+bench_plain(world const& w, pairs_type const& pairs) {
+  std::atomic<bool> stop{false};
+  return measure(pairs, [&] (position from, position to, result& r) {
+    Search search(from, to, w, stop);
+    r.path_length += search.find_path(w).size();
+    r.expanded += search.nodes_expanded();
+  });
+}
+
+template <template <typename> class Queue>
+result
+bench_jps(world const& w, pairs_type const& pairs) {
+  std::atomic<bool> stop{false};
+  return measure(pairs, [&] (position from, position to, result& r) {
+    plain_jps_search<Queue> search(
+      from, to, w, stop, manhattan_distance_heuristic{to},
+      manhattan_step_cost{}, always_passable{},
+      jps_successors<static_passable>{to, {}}
+    );
+    r.path_length += expand_jumps(search.find_path(w)).size();
+    r.expanded += search.nodes_expanded();
+  });
+}
+
+// Returns the time to place the landmarks and their memory too.
+std::tuple<result, double, std::size_t>
+bench_alt(world const& w, landmark_selection selection, unsigned count,
+          pairs_type const& pairs) {
+  auto const start = std::chrono::steady_clock::now();
+  landmarks const lm{w.map(), count, selection};
+  double const setup_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start
+  ).count();
+
+  std::atomic<bool> stop{false};
+  result r = measure(pairs, [&] (position from, position to, result& r) {
+    alt_search search(from, to, w, stop, alt_heuristic{&lm, to},
+                      unitary_step_cost{});
+    r.path_length += search.find_path(w).size();
+    r.expanded += search.nodes_expanded();
+  });
+
+  return std::make_tuple(r, setup_ms, lm.memory());
+}
+
+// Walk from each start at most steps steps towards the goal. Before each step,
+// each tile next to the agent is blocked with probability 1/4, depending only
+// on the tile and the step, and a new path is found by
+// replan(from, to, blocked, r).
+template <typename Replan>
+result
+bench_replan(world const& w, pairs_type const& pairs, unsigned steps,
+             Replan replan) {
+  return measure(pairs, [&] (position from, position to, result& r) {
+    std::vector<position> blocked;
+    for (unsigned step = 0; step < steps && from != to; ++step) {
+      blocked.clear();
+      for (position n : w.map()->adjacent(from))
+        if (((n.x * 73856093u ^ n.y * 19349663u ^ step * 83492791u) >> 13)
+            % 4 == 0)
+          blocked.push_back(n);
+
+      path<> const p = replan(from, to, blocked, r);
+      r.path_length += p.size();
+      if (p.size() >= 2)
+        from = p[p.size() - 2];
+    }
+  });
+}
+
+struct static_passable_step {
+  bool operator () (position, position, world const&, unsigned) const {
+    return true;
+  }
+};
+
+// Returns the time to build the hierarchy and its memory too.
+std::tuple<result, double, std::size_t>
+bench_hpa(world const& w, unsigned cluster_size, pairs_type const& pairs) {
+  auto const start = std::chrono::steady_clock::now();
+  cluster_hierarchy const h{w.map(), cluster_size};
+  double const setup_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start
+  ).count();
+
+  std::atomic<bool> stop{false};
+  hierarchical_search<static_passable_step> search;
+  result r = measure(pairs, [&] (position from, position to, result& r) {
+    r.path_length += search.find_path(
+      h, from, to, w, stop, static_passable_step{},
+      manhattan_distance_heuristic{to}
+    ).size();
+    r.expanded += search.nodes_expanded();
+  });
+
+  return std::make_tuple(r, setup_ms, h.memory());
+}
+
+template <template <typename> class Queue>
+result
+bench_space_time(world const& w, predictor* p, unsigned window,
+                 pairs_type const& pairs) {
+  std::atomic<bool> stop{false};
+  return measure(pairs, [&] (position from, position to, result& r) {
+    space_time_search<Queue> search(
+      from, to, w, stop, manhattan_distance_heuristic{to},
+      predicted_cost{p, w.tick(), 10}
+    );
+    r.path_length += search.find_path_to_goal_or_window(w, window).size();
+    r.expanded += search.nodes_expanded();
+  });
+}
+
+void
+print(std::string const& search, std::string const& queue, result r) {
+  std::cout << std::left << std::setw(12) << search
+            << std::setw(12) << queue
+            << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << r.time_ms
+            << std::setw(12) << r.expanded
+            << std::setw(12) << r.path_length << '\n';
+}
+
+pairs_type
+random_pairs(map const& m, unsigned count, std::default_random_engine& rng) {
+  std::vector<position> passable;
+  m.foreach_passable([&] (position p) { passable.push_back(p); });
+
+  pairs_type result;
+  if (passable.empty())
+    return result;
+
+  std::uniform_int_distribution<std::size_t> pick(0, passable.size() - 1);
+  for (unsigned i = 0; i < count; ++i)
+    result.emplace_back(passable[pick(rng)], passable[pick(rng)]);
+
+  return result;
+}
+
+}
+
+int
+main(int argc, char** argv) try {
+  namespace po = boost::program_options;
+
+  po::options_description desc;
+  desc.add_options()
+    ("help,h", "This text")
+    ("map,m", po::value<std::vector<std::string>>(), "Map to search on")
+    ("pairs,p", po::value<unsigned>()->default_value(50),
+     "Number of start-goal pairs per map")
+    ("window,w", po::value<unsigned>()->default_value(20),
+     "Window of the space-time search")
+    ("seed", po::value<unsigned>()->default_value(0), "Random seed to use")
+    ("landmarks", po::value<unsigned>()->default_value(8),
+     "Number of landmarks for the ALT heuristic")
+    ("replan-steps", po::value<unsigned>()->default_value(50),
+     "Number of steps to walk when measuring replanning")
+    ;
+
+  po::positional_options_description positional;
+  positional.add("map", -1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+              .options(desc).positional(positional).run(),
+            vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("map")) {
+    std::cout << "Usage: bench [options] MAP...\n" << desc << '\n';
+    return vm.count("help") ? 0 : 1;
+  }
+
+  std::default_random_engine rng(vm["seed"].as<unsigned>());
+  unsigned const window = vm["window"].as<unsigned>();
+  unsigned const landmarks_count = vm["landmarks"].as<unsigned>();
+  unsigned const replan_steps = vm["replan-steps"].as<unsigned>();
+
+  for (std::string const& filename : vm["map"].as<std::vector<std::string>>()) {
+    world w(load_map(filename));
+    w.spawn_obstacles(rng);
+
+    std::unique_ptr<predictor> p = make_recursive_predictor(w, 5);
+    p->update_obstacles(w);
+
+    pairs_type const pairs =
+      random_pairs(*w.map(), vm["pairs"].as<unsigned>(), rng);
+
+    std::cout << filename << ": " << pairs.size() << " pairs\n"
+              << std::left << std::setw(12) << "search"
+              << std::setw(12) << "queue"
+              << std::right << std::setw(12) << "time [ms]"
+              << std::setw(12) << "expanded"
+              << std::setw(12) << "path nodes" << '\n';
+
+    print("plain", "fibonacci",
+          bench_plain<plain_search<fibonacci_queue>>(w, pairs));
+    print("plain", "binary",
+          bench_plain<plain_search<binary_queue>>(w, pairs));
+    print("plain", "4-ary",
+          bench_plain<plain_search<four_ary_queue>>(w, pairs));
+    print("plain", "bucket",
+          bench_plain<plain_search<bucket_queue>>(w, pairs));
+    print("plain", "radix",
+          bench_plain<plain_search<radix_queue>>(w, pairs));
+
+    print("plain grid", "fibonacci",
+          bench_plain<plain_grid_search<fibonacci_queue>>(w, pairs));
+    print("plain grid", "4-ary",
+          bench_plain<plain_grid_search<four_ary_queue>>(w, pairs));
+    print("plain grid", "bucket",
+          bench_plain<plain_grid_search<bucket_queue>>(w, pairs));
+    print("plain grid", "radix",
+          bench_plain<plain_grid_search<radix_queue>>(w, pairs));
+
+    print("plain jps", "4-ary", bench_jps<four_ary_queue>(w, pairs));
+    print("plain jps", "radix", bench_jps<radix_queue>(w, pairs));
+
+    for (auto selection : {landmark_selection::farthest,
+                           landmark_selection::planar,
+                           landmark_selection::avoid}) {
+      static char const* const names[] = {"farthest", "planar", "avoid"};
+      auto const r = bench_alt(w, selection, landmarks_count, pairs);
+      print("alt", names[(int) selection], std::get<0>(r));
+      std::cout << "  (landmarks placed in " << std::get<1>(r) << " ms, "
+                << std::get<2>(r) / 1024 << " KiB)\n";
+    }
+
+    for (unsigned cluster_size : {8u, 16u, 32u}) {
+      auto const r = bench_hpa(w, cluster_size, pairs);
+      print("hpa", "cluster " + std::to_string(cluster_size), std::get<0>(r));
+      std::cout << "  (hierarchy built in " << std::get<1>(r) << " ms, "
+                << std::get<2>(r) / 1024 << " KiB)\n";
+    }
+
+    std::atomic<bool> stop{false};
+    print("replan jps", "radix", bench_replan(
+      w, pairs, replan_steps,
+      [&] (position from, position to, std::vector<position> const& blocked,
+           result& r) {
+        replan_jps_search search(
+          from, to, w, stop, manhattan_distance_heuristic{to},
+          manhattan_step_cost{}, always_passable{},
+          jps_successors<not_blocked>{to, not_blocked{&blocked}}
+        );
+        path<> const result = expand_jumps(search.find_path(w));
+        r.expanded += search.nodes_expanded();
+        return result;
+      }
+    ));
+
+    std::unique_ptr<d_star_lite> incremental;
+    print("replan d*", "binary", bench_replan(
+      w, pairs, replan_steps,
+      [&] (position from, position to, std::vector<position> const& blocked,
+           result& r) {
+        if (!incremental || incremental->goal() != to)
+          incremental = std::make_unique<d_star_lite>(w.map(), to);
+
+        path<> const result = incremental->find_path(from, blocked, stop);
+        r.expanded += incremental->nodes_expanded();
+        return result;
+      }
+    ));
+
+    print("space-time", "fibonacci",
+          bench_space_time<fibonacci_queue>(w, p.get(), window, pairs));
+    print("space-time", "binary",
+          bench_space_time<binary_queue>(w, p.get(), window, pairs));
+    print("space-time", "4-ary",
+          bench_space_time<four_ary_queue>(w, p.get(), window, pairs));
+    print("space-time", "radix",
+          bench_space_time<radix_queue>(w, p.get(), window, pairs));
+
+    std::cout << '\n';
+  }
+
+} catch (bad_world_format& e) {
+  std::cerr << "World format error: " << e.what() << '\n';
+  return 1;
+} catch (boost::program_options::error& e) {
+  std::cerr << "Bad option: " << e.what() << '\n';
+  return 1;
+} catch (std::runtime_error& e) {
+  std::cerr << "Error: " << e.what() << '\n';
+  return 2;
+}
@@ -1,3 +1,5 @@
+#include "hpa.hpp"
+#include "landmarks.hpp"
 #include "log_sinks.hpp"
 #include "predictor.hpp"
 #include "solvers.hpp"
@@ -34,7 +36,9 @@ make_predictor(std::string const& name,
 static std::unique_ptr<solver>
 make_solver(std::string const& name,
             boost::program_options::variables_map const& vm,
-            world const& world) {
+            world const& world,
+            std::shared_ptr<landmarks const> landmarks,
+            std::shared_ptr<cluster_hierarchy const> hierarchy) {
   using boost::algorithm::iequals;
 
   std::unique_ptr<predictor> predictor;
@@ -62,7 +66,11 @@ make_solver(std::string const& name,
       rejoin_limit,
       std::move(predictor),
       obstacle_penalty,
-      obstacle_threshold
+      obstacle_threshold,
+      std::move(landmarks),
+      vm.count("sipp"),
+      vm["threads"].as<unsigned>(),
+      vm["heuristic-tolerance"].as<double>()
     );
   }
 
@@ -70,11 +78,13 @@ make_solver(std::string const& name,
     return make_lra(null_log_sink,
                     rejoin_limit,
                     std::move(predictor), obstacle_penalty,
-                    obstacle_threshold);
+                    obstacle_threshold, std::move(landmarks),
+                    vm.count("incremental"), std::move(hierarchy));
 
   if (iequals(name, "od"))
     return make_od(window, std::move(predictor),
-                   obstacle_penalty, obstacle_threshold);
+                   obstacle_penalty, obstacle_threshold,
+                   std::move(landmarks));
 
   throw std::runtime_error{std::string{"Unknown solver type: "} + name};
 }
@@ -103,6 +113,29 @@ main(int argc, char** argv) try {
      "considered impassable")
     ("predictor-cutoff", po::value<unsigned>()->default_value(5),
      "Maximum number of steps the predictor will predict")
+    ("sipp", "WHCA*: search safe intervals instead of single steps")
+    ("threads", po::value<unsigned>()->default_value(1),
+     "WHCA*: plan agents speculatively on this many threads, keeping the "
+     "result of planning them one by one")
+    ("heuristic-tolerance", po::value<double>()->default_value(1.0),
+     "WHCA*: with a predictor, keep an agent's heuristic search across replans "
+     "until the step costs of its next window of steps have changed by more "
+     "than this in total; negative to rebuild it at every replan")
+    ("incremental",
+     "LRA*: replan incrementally with D* Lite; can't be used with a "
+     "predictor")
+    ("hierarchy", po::value<unsigned>()->default_value(0),
+     "LRA*: search a hierarchy of clusters of this size first; 0 to search "
+     "the full map only")
+    ("landmarks", po::value<unsigned>()->default_value(0),
+     "Number of landmarks for the ALT heuristic; 0 to use plain Manhattan "
+     "distance")
+    ("landmark-selection",
+     po::value<std::string>()->default_value("farthest"),
+     "How to place landmarks: farthest, planar or avoid")
+    ("cache-map",
+     "Write a binary cache of the scenario's map next to it, if there isn't "
+     "an up-to-date one yet, so that later runs load the map faster")
     ;
 
   po::variables_map vm;
@@ -129,7 +162,24 @@ main(int argc, char** argv) try {
     rng.seed(vm["seed"].as<unsigned>());
 
   world w = load_world(vm["scenario"].as<std::string>(), rng);
-  auto solver = make_solver(vm["algorithm"].as<std::string>(), vm, w);
+
+  if (vm.count("cache-map")
+      && !map_cache_current(w.map()->original_filename()))
+    save_map_cache(*w.map());
+
+  std::shared_ptr<landmarks const> lm;
+  if (unsigned const count = vm["landmarks"].as<unsigned>())
+    lm = std::make_shared<landmarks>(
+      w.map(), count,
+      landmark_selection_from_string(vm["landmark-selection"].as<std::string>())
+    );
+
+  std::shared_ptr<cluster_hierarchy const> hierarchy;
+  if (unsigned const cluster_size = vm["hierarchy"].as<unsigned>())
+    hierarchy = std::make_shared<cluster_hierarchy>(w.map(), cluster_size);
+
+  auto solver = make_solver(vm["algorithm"].as<std::string>(), vm, w, lm,
+                            hierarchy);
 
   unsigned const limit = vm.count("limit") ? vm["limit"].as<unsigned>() : 0;
 
@@ -162,6 +212,11 @@ main(int argc, char** argv) try {
       ++agents_solved;
   results.add("agents_solved", agents_solved);
 
+  if (lm)
+    results.add("landmark_memory_bytes", lm->memory());
+  if (hierarchy)
+    results.add("hierarchy_memory_bytes", hierarchy->memory());
+
   pt::ptree algo_stats;
   auto names = solver->stat_names();
   auto values = solver->stat_values();
@@ -1,17 +1,20 @@
 #ifndef A_STAR_HPP
 #define A_STAR_HPP
 
+#include "grid_table.hpp"
+#include "priority_queue.hpp"
 #include "world.hpp"
 
-#include <boost/heap/fibonacci_heap.hpp>
 #include <boost/optional.hpp>
-#include <boost/pool/object_pool.hpp>
-#include <boost/pool/pool.hpp>
 
 #include <atomic>
 #include <limits>
+#include <memory>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 struct always_passable {
   template <typename State>
@@ -40,6 +43,14 @@ struct unitary_step_cost {
   operator () (T, T, unsigned) const { return 1.0; }
 };
 
+// Uniform cost of steps that may span several tiles in a straight line.
+struct manhattan_step_cost {
+  double
+  operator () (position from, position to, unsigned) const {
+    return distance(from, to);
+  }
+};
+
 template <typename StateT = position>
 struct space_coordinate {
   using type = StateT;
@@ -55,8 +66,58 @@ struct space_time_coordinate {
   make(position p, unsigned g) { return position_time{p, g}; }
 };
 
+// Adapters giving the hash containers the interface a_star uses for its
+// tables, which is shared with grid_table and grid_set.
+template <typename Key, typename Value>
+class hash_table {
+public:
+  void prepare(map const&) { }
+
+  Value*
+  find(Key const& k) {
+    auto it = table_.find(k);
+    return it != table_.end() ? &it->second : nullptr;
+  }
+
+  Value const*
+  find(Key const& k) const { return const_cast<hash_table*>(this)->find(k); }
+
+  bool count(Key const& k) const    { return table_.count(k); }
+  void insert(Key const& k, Value v) { table_.insert({k, std::move(v)}); }
+  void erase(Key const& k)          { table_.erase(k); }
+  void clear()                      { table_.clear(); }
+
+private:
+  std::unordered_map<Key, Value> table_;
+};
+
+template <typename Key>
+class hash_set {
+public:
+  void prepare(map const&) { }
+  void clear()                     { set_.clear(); }
+  void insert(Key const& k)        { set_.insert(k); }
+  bool count(Key const& k) const   { return set_.count(k); }
+
+  template <typename F>
+  void
+  foreach(F f) const {
+    for (Key const& k : set_)
+      f(k);
+  }
+
+private:
+  std::unordered_set<Key> set_;
+};
+
 template <typename State, typename Node>
 struct no_distance_storage {
+  void
+  prepare(map const&) { }
+
+  void
+  clear() { }
+
   void
   store(State, Node) { }
 
@@ -66,31 +127,58 @@ struct no_distance_storage {
 
 template <typename State, typename Node>
 struct position_distance_storage {
-  using storage_type = std::unordered_map<State, Node>;
+  using storage_type = hash_table<State, Node>;
 
   storage_type storage;
 
+  void
+  prepare(map const& m) { storage.prepare(m); }
+
+  void
+  clear() { storage.clear(); }
+
   void
   store(State s, Node n) {
-    storage.insert({s, n});
+    storage.insert(s, n);
   }
 
   storage_type const&
   get() const { return storage; }
 };
 
-struct position_successors {
-  static std::vector<position>
-  get(position p, world const& w) {
-    std::vector<position> result;
-
-    for (direction d : all_directions) {
-      position const n = translate(p, d);
-      if (in_bounds(n, *w.map()) && w.get(n) != tile::wall)
-        result.push_back(n);
-    }
+// Distance storage in a grid_table; only for State = position.
+template <typename State, typename Node>
+struct grid_distance_storage : position_distance_storage<State, Node> { };
 
-    return result;
+template <typename Node>
+struct grid_distance_storage<position, Node> {
+  using storage_type = grid_table<Node>;
+
+  storage_type storage;
+
+  void
+  prepare(map const& m) { storage.prepare(m); }
+
+  void
+  clear() { storage.clear(); }
+
+  void
+  store(position p, Node n) {
+    storage.insert(p, n);
+  }
+
+  storage_type const&
+  get() const { return storage; }
+};
+
+// Successors of a position are its passable neighbours, taken from the map's
+// precomputed adjacency graph.
+struct position_successors {
+  template <typename F>
+  static void
+  visit(position p, position const*, world const& w, F f) {
+    for (position n : w.map()->adjacent(p))
+      f(n);
   }
 };
 
@@ -102,7 +190,78 @@ struct always_close {
 
 template <typename Coord, typename Handle>
 struct coord_open_set {
-  using type = std::unordered_map<Coord, Handle>;
+  using type = hash_table<Coord, Handle>;
+};
+
+template <typename Coord>
+struct coord_closed_set {
+  using type = hash_set<Coord>;
+};
+
+// Open and closed sets in grid tables, for searches whose coordinate is a
+// position. These avoid hashing altogether.
+template <typename Coord, typename Handle>
+struct grid_open_set {
+  static_assert(std::is_same<Coord, position>::value,
+                "Grid tables need position coordinates");
+  using type = grid_table<Handle>;
+};
+
+template <typename Coord>
+struct grid_closed_set {
+  static_assert(std::is_same<Coord, position>::value,
+                "Grid tables need position coordinates");
+  using type = grid_set;
+};
+
+// Storage for objects that are all destroyed together. The memory is kept
+// when the arena is cleared, so an arena that's reused stops allocating once it
+// has grown large enough. Objects never move.
+template <typename T>
+class arena {
+public:
+  arena() = default;
+  arena(arena&& other)
+    : blocks_(std::move(other.blocks_))
+    , size_(std::exchange(other.size_, 0))
+  { }
+
+  arena&
+  operator = (arena&& other) {
+    clear();
+    blocks_ = std::move(other.blocks_);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  ~arena() { clear(); }
+
+  template <typename... Args>
+  T*
+  construct(Args&&... args) {
+    if (size_ == blocks_.size() * block_size)
+      blocks_.push_back(std::make_unique<slot[]>(block_size));
+
+    T* result = new (&blocks_[size_ / block_size][size_ % block_size])
+      T(std::forward<Args>(args)...);
+    ++size_;
+    return result;
+  }
+
+  void
+  clear() {
+    if (!std::is_trivially_destructible<T>::value)
+      for (std::size_t i = 0; i < size_; ++i)
+        reinterpret_cast<T*>(&blocks_[i / block_size][i % block_size])->~T();
+    size_ = 0;
+  }
+
+private:
+  static constexpr std::size_t block_size = 1024;
+  using slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  std::vector<std::unique_ptr<slot[]>> blocks_;
+  std::size_t size_ = 0;
 };
 
 constexpr unsigned
@@ -116,7 +275,12 @@ infinity = std::numeric_limits<unsigned>::max();
 //   * State: The state-space the algorithm will search. This can be `position`
 //            for plain A* search or `agents_state` for operator decomposition.
 //   * SuccessorsFunc: Policy type for getting the successors of a State. Either
-//                     `position_successors` or `state_successors`.
+//                     `position_successors`, `state_successors` or
+//                     `jps_successors`. Its visit(state, parent, world, f)
+//                     calls f(successor) for each successor; the successor
+//                     need only live for the call. parent is null for the
+//                     start. The search holds one instance, which may keep
+//                     scratch space and is set on reset.
 //   * Passable: Policy type for determining whether to add a successor to the
 //               heap or whether to consider it impassable. Can be used to
 //               consider obstacles in the immediate neighbourhood to be
@@ -135,10 +299,21 @@ infinity = std::numeric_limits<unsigned>::max();
 //                 different, so the post-move coordinate of an empty move is
 //                 not the same as the pre-move coordinate.
 //   * DistanceStorage: Policy for storing distances from start of search to any
-//                      node in the closed set.
+//                      node in the closed set. Either
+//                      `position_distance_storage` or `grid_distance_storage`,
+//                      or `no_distance_storage`.
 //   * ShouldClosePred: Whether a node should be inserted into the closed set.
 //                      Used with OD to close only full states.
-//   * OpenSetType: Type of the open set.
+//   * OpenSetType: Type of the open set. Either `coord_open_set` or, for
+//                  position coordinates, `grid_open_set`.
+//   * Queue: Priority queue policy from priority_queue.hpp. The bucket queue
+//            requires integer f values and the radix queue monotone ones.
+//   * ClosedSetType: Type of the closed set. Either `coord_closed_set` or, for
+//                    position coordinates, `grid_closed_set`.
+//
+// A search can be reset to start over with different endpoints and policies.
+// The nodes, the heap and the tables keep their memory, so a solver holding
+// one search object and resetting it doesn't allocate once it's warmed up.
 template <
   typename State = position,
   typename SuccessorsFunc = position_successors,
@@ -150,30 +325,30 @@ template <
     position_distance_storage,
   typename ShouldClosePred = always_close<typename Coordinate::type>,
   template <typename, typename> class OpenSetType =
-    coord_open_set
+    coord_open_set,
+  template <typename> class Queue = fibonacci_queue,
+  template <typename> class ClosedSetType = coord_closed_set
 >
 class a_star {
 public:
+  // Search with nothing to search for. reset has to be called before it's
+  // used.
+  a_star() = default;
+
   a_star(State const& from, State const& to, world const& w,
          std::atomic<bool>& stop_flag, Passable passable = Passable{})
-    : a_star(from, to, w, stop_flag, Distance{to}, StepCost{}, passable) { }
+  {
+    reset(from, to, w, stop_flag, std::move(passable));
+  }
 
   a_star(State const& from, State const& to, world const& w,
          std::atomic<bool>& stop_flag,
          Distance distance, StepCost step_cost,
-         Passable passable = Passable{})
-    : from_(from)
-    , to_(to)
-    , passable_(std::move(passable))
-    , distance_(std::move(distance))
-    , step_cost_(std::move(step_cost))
-    , stop_flag_{&stop_flag}
+         Passable passable = Passable{},
+         SuccessorsFunc successors = SuccessorsFunc{})
   {
-    node* start = node_pool_.construct(
-      node(from, 0.0, distance_(from, w), 0u)
-    );
-    handle_type h = heap_.push(start);
-    open_.insert({Coordinate::make(from, 0), h});
+    reset(from, to, w, stop_flag, std::move(distance), std::move(step_cost),
+          std::move(passable), std::move(successors));
   }
 
   a_star(a_star const&) = delete;
@@ -182,6 +357,52 @@ public:
   a_star(a_star&&) = default;
   a_star& operator = (a_star&&) = default;
 
+  // Discard the current search and start a new one, as if newly constructed.
+  void
+  reset(State const& from, State const& to, world const& w,
+        std::atomic<bool>& stop_flag, Passable passable = Passable{}) {
+    reset(from, to, w, stop_flag, Distance{to}, StepCost{},
+          std::move(passable));
+  }
+
+  void
+  reset(State const& from, State const& to, world const& w,
+        std::atomic<bool>& stop_flag,
+        Distance distance, StepCost step_cost,
+        Passable passable = Passable{},
+        SuccessorsFunc successors = SuccessorsFunc{}) {
+    if (map_ != w.map()) {
+      map_ = w.map();
+      open_.prepare(*map_);
+      closed_.prepare(*map_);
+      distance_storage_.prepare(*map_);
+    } else {
+      open_.clear();
+      closed_.clear();
+      distance_storage_.clear();
+    }
+
+    heap_.clear();
+    nodes_.clear();
+    expanded_ = 0;
+
+    from_ = from;
+    to_ = to;
+    passable_.emplace(std::move(passable));
+    distance_.emplace(std::move(distance));
+    step_cost_.emplace(std::move(step_cost));
+    successors_ = std::move(successors);
+    stop_flag_ = &stop_flag;
+
+    node* start = nodes_.construct(from, 0.0, (*distance_)(from, w), 0u);
+    handle_type h = heap_.push(start);
+    open_.insert(Coordinate::make(from, 0), h);
+  }
+
+  // Step cost used for the nodes expanded from now on.
+  StepCost&
+  step_cost() { return *step_cost_; }
+
   // Find path from the starting position to the goal position the search was
   // initialised with.
   path<State>
@@ -211,6 +432,42 @@ public:
     );
   }
 
+  // Like find_path(w, window), but nodes may be finished without searching
+  // further. Before each node fewer than `window` steps from the start is
+  // expanded, complete(position, steps, w, rest, unseen) is called, where
+  // unseen(position, steps) tells whether that coordinate is neither open nor
+  // closed. If it returns true, having filled rest with positions, one per step
+  // up to the window, the node isn't expanded and the end of that path is
+  // queued in its place. complete must only do this when the search would go
+  // on to return that path anyway.
+  template <typename Complete>
+  path<State>
+  find_path_completing(world const& w, unsigned window, Complete complete) {
+    std::vector<State> rest;
+    auto unseen = [&] (State const& p, unsigned steps) {
+      coordinate_type const coord = Coordinate::make(p, steps);
+      return !open_.find(coord) && !closed_.count(coord);
+    };
+
+    return do_find_path(
+      w,
+      [&] (node const* n) { return n->steps_distance == window; },
+      std::numeric_limits<unsigned>::max(),
+      [&] (node* n) {
+        if (n->steps_distance >= window)
+          return true;
+
+        rest.clear();
+        if (!complete(n->pos, n->steps_distance, w, rest, unseen))
+          return true;
+
+        assert(rest.size() == window - n->steps_distance);
+        queue_completion(n, rest, w);
+        return false;
+      }
+    );
+  }
+
   // Find goal to a position that satisfies the given predicate. `limit` is the
   // furthest number of steps the algorithm will search before returning the
   // empty path.
@@ -227,19 +484,30 @@ public:
   find_distance(State const& p, world const& w) {
     auto const& shortest_paths = distance_storage_.get();
 
-    auto it = shortest_paths.find(p);
-    if (it != shortest_paths.end())
-      return it->second->g;
+    if (node* const* n = shortest_paths.find(p))
+      return (*n)->g;
 
     expand_until([&] (node const* n) { return n->pos == p; }, w);
 
-    it = shortest_paths.find(p);
-    if (it != shortest_paths.end())
-      return it->second->g;
+    if (node* const* n = shortest_paths.find(p))
+      return (*n)->g;
     else
       return infinity;
   }
 
+  // Call f(from, to, distance, cost) on each step of the shortest path found to
+  // p, going from p back to the start, where distance is the number of steps
+  // from the start to `to` and cost is the step cost used for it. Does nothing
+  // if p isn't closed.
+  template <typename F>
+  void
+  foreach_step_to(State const& p, F&& f) const {
+    if (node* const* n = distance_storage_.get().find(p))
+      for (node const* m = *n; m->come_from; m = m->come_from)
+        f(m->come_from->pos, m->pos, m->steps_distance,
+          m->g - m->come_from->g);
+  }
+
   unsigned nodes_expanded() const { return expanded_; }
 
   State const& from() const { return from_; }
@@ -249,8 +517,7 @@ public:
   template <typename F>
   void
   foreach_closed(F&& f) {
-    for (coordinate_type const& position : closed_)
-      f(position);
+    closed_.foreach(f);
   }
 
 private:
@@ -268,21 +535,9 @@ private:
     double f() const { return g + h; }
   };
 
-  struct node_comparator {
-    bool
-    operator () (node* x, node* y) const {
-      return x->f() > y->f();
-    }
-  };
-
-  using heap_type = boost::heap::fibonacci_heap<
-    node*, boost::heap::compare<node_comparator>
-  >;
+  using heap_type = Queue<node>;
   using handle_type = typename heap_type::handle_type;
 
-  using pool_type =
-    boost::object_pool<node, boost::default_user_allocator_new_delete>;
-
   using coordinate_type = typename Coordinate::type;
 
   using open_set_type =
@@ -290,24 +545,31 @@ private:
 
   State from_;
   State to_;
+  std::shared_ptr<map const> map_;  // Map the tables are prepared for.
   heap_type heap_;
   unsigned expanded_ = 0;
-  pool_type node_pool_;
+  arena<node> nodes_;
+  SuccessorsFunc successors_;
   open_set_type open_;
-  std::unordered_set<coordinate_type> closed_;
+  typename ClosedSetType<coordinate_type>::type closed_;
   DistanceStorage<State, node*> distance_storage_;
-  Passable passable_;
-  Distance distance_;
-  StepCost step_cost_;
-  std::atomic<bool>* stop_flag_;
+  boost::optional<Passable> passable_;
+  boost::optional<Distance> distance_;
+  boost::optional<StepCost> step_cost_;
+  std::atomic<bool>* stop_flag_ = nullptr;
+
+  struct expand_all {
+    bool operator () (node*) const { return true; }
+  };
 
-  template <typename EndPred>
+  template <typename EndPred, typename ExpandPred = expand_all>
   path<State>
   do_find_path(world const& w, EndPred goal,
-               unsigned limit = std::numeric_limits<unsigned>::max()) {
+               unsigned limit = std::numeric_limits<unsigned>::max(),
+               ExpandPred expand = ExpandPred{}) {
     path<State> result;
 
-    node* current = expand_until(goal, w, limit);
+    node* current = expand_until(goal, w, limit, expand);
     if (!current)
       return {};
 
@@ -319,10 +581,13 @@ private:
     return result;
   }
 
-  template <typename EndF>
+  // Nodes for which expand returns false are closed without generating their
+  // successors.
+  template <typename EndF, typename ExpandF = expand_all>
   node*
   expand_until(EndF end, world const& w,
-               unsigned limit = std::numeric_limits<unsigned>::max()) {
+               unsigned limit = std::numeric_limits<unsigned>::max(),
+               ExpandF expand = ExpandF{}) {
     while (!heap_.empty()) {
       if (stop_flag_ && *stop_flag_)
         return nullptr;
@@ -338,7 +603,7 @@ private:
       open_.erase(current_coord);
 
       if (ShouldClosePred::get(current_coord))
-        closed_.insert({current_coord});
+        closed_.insert(current_coord);
 
       distance_storage_.store(current->pos, current);
 
@@ -347,45 +612,60 @@ private:
       if (current->steps_distance == limit)
         return nullptr;
 
-      std::vector<State> neighbours = SuccessorsFunc::get(current->pos, w);
-
-      if (Coordinate::make(current->pos, current->steps_distance + 1)
-          != current_coord)
-        neighbours.push_back(current->pos);
+      if (!expand(current))
+        continue;
 
-      for (State const& neighbour : neighbours) {
+      auto visit = [&] (State const& neighbour) {
         coordinate_type const neighbour_coord =
           Coordinate::make(neighbour, current->steps_distance + 1);
 
         if (closed_.count(neighbour_coord))
-          continue;
-
-        if (!passable_(neighbour, current->pos, w, current->steps_distance + 1))
-          continue;
-
-        double step_cost = step_cost_(current_coord, neighbour_coord,
-                                      current->steps_distance + 1);
-        auto n = open_.find(neighbour_coord);
-        if (n != open_.end()) {
-          handle_type neighbour_handle = n->second;
-          if ((**neighbour_handle).g > current->g + step_cost) {
-            (**neighbour_handle).g = current->g + step_cost;
-            (**neighbour_handle).come_from = current;
-            (**neighbour_handle).steps_distance = current->steps_distance + 1;
-            heap_.decrease(neighbour_handle);
+          return;
+
+        if (!(*passable_)(neighbour, current->pos, w,
+                          current->steps_distance + 1))
+          return;
+
+        double step_cost = (*step_cost_)(current_coord, neighbour_coord,
+                                         current->steps_distance + 1);
+        if (handle_type* n = open_.find(neighbour_coord)) {
+          handle_type neighbour_handle = *n;
+          node* const neighbour_node = heap_type::get(neighbour_handle);
+          if (neighbour_node->g > current->g + step_cost) {
+            double const old_f = neighbour_node->f();
+            neighbour_node->g = current->g + step_cost;
+            neighbour_node->come_from = current;
+            neighbour_node->steps_distance = current->steps_distance + 1;
+
+            // g can decrease by less than f can resolve. The node then keeps
+            // its place, and pushing it again to a lazy-deletion queue would
+            // leave two live entries for it.
+            if (neighbour_node->f() != old_f)
+              heap_.decrease_key(neighbour_handle);
           }
 
         } else {
-          node* neighbour_node = node_pool_.construct(node(
+          node* neighbour_node = nodes_.construct(
             neighbour, current->g + step_cost,
-            distance_(neighbour, w),
+            (*distance_)(neighbour, w),
             current->steps_distance + 1
-          ));
+          );
           handle_type h = heap_.push(neighbour_node);
           neighbour_node->come_from = current;
-          open_.insert({neighbour_coord, h});
+          open_.insert(neighbour_coord, h);
         }
-      }
+      };
+
+      successors_.visit(
+        current->pos, current->come_from ? &current->come_from->pos : nullptr,
+        w, visit
+      );
+
+      // The empty move is only a distinct successor if the coordinate includes
+      // time.
+      if (Coordinate::make(current->pos, current->steps_distance + 1)
+          != current_coord)
+        visit(current->pos);
 
       if (end(current))
         return current;
@@ -393,6 +673,46 @@ private:
 
     return nullptr;
   }
+
+  // Queue the end of the path made of from followed by rest, as though the
+  // search had got there.
+  void
+  queue_completion(node* from, std::vector<State> const& rest, world const& w) {
+    node* last = from;
+    for (State const& p : rest) {
+      unsigned const steps = last->steps_distance + 1;
+      double const step_cost = (*step_cost_)(
+        Coordinate::make(last->pos, last->steps_distance),
+        Coordinate::make(p, steps), steps
+      );
+      node* const n = nodes_.construct(p, last->g + step_cost, 0.0, steps);
+      n->come_from = last;
+      last = n;
+    }
+
+    last->h = (*distance_)(last->pos, w);
+
+    coordinate_type const coord =
+      Coordinate::make(last->pos, last->steps_distance);
+    if (closed_.count(coord))
+      return;
+
+    if (handle_type* h = open_.find(coord)) {
+      node* const existing = heap_type::get(*h);
+      if (existing->g > last->g) {
+        double const old_f = existing->f();
+        existing->g = last->g;
+        existing->come_from = last->come_from;
+
+        // As in expand_until.
+        if (existing->f() != old_f)
+          heap_.decrease_key(*h);
+      }
+      return;
+    }
+
+    open_.insert(coord, heap_.push(last));
+  }
 };
 
 #endif
@@ -104,20 +104,7 @@ operator << (std::ostream& out, joint_action const& a) {
 
 world
 apply(joint_action const& a, world const& w) {
-  world result{w.map(), w.obstacle_settings(), w.agent_settings(),
-               w.obstacles(), w.tick()};
-
-  for (auto const& pos_agent : w.agents()) {
-    position const p = pos_agent.first;
-    agent const& agent = pos_agent.second;
-
-    if (auto action = a.action_for(p)) {
-      position const d = translate(p, action->where());
-      result.put_agent(d, agent);
-    } else {
-      result.put_agent(p, agent);
-    }
-  }
-
+  world result = w;
+  result.apply(a);
   return result;
 }
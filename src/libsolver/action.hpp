@@ -66,6 +66,18 @@ public:
   boost::optional<action>
   action_for(position) const;
 
+  // Number of agents that move in this action.
+  std::size_t
+  size() const { return actions_.size(); }
+
+  // Call a function on each action contained in this joint action.
+  template <typename F>
+  void
+  foreach_action(F&& f) const {
+    for (auto const& pos_dir : actions_)
+      f(action{pos_dir.first, pos_dir.second});
+  }
+
   void
   show(std::ostream&) const;
 
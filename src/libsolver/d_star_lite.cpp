@@ -0,0 +1,215 @@
+#include "d_star_lite.hpp"
+
+#include <algorithm>
+
+constexpr unsigned d_star_lite::infinity;
+
+d_star_lite::d_star_lite(std::shared_ptr<::map const> m, position goal,
+                         landmarks const* landmarks)
+  : map_(std::move(m))
+  , goal_(goal)
+  , landmarks_(landmarks)
+  , start_(goal)
+  , heuristic_(landmarks, goal)
+{
+  nodes_.prepare(*map_);
+  at(goal_).rhs = 0;
+  update(goal_);
+}
+
+path<>
+d_star_lite::find_path(position start, std::vector<position> blocked,
+                       std::atomic<bool> const& stop) {
+  nodes_expanded_ = 0;
+
+  if (start != start_) {
+    // Keys already in the queue were computed with the heuristic from the old
+    // start, which may be higher by up to the distance moved. Rather than
+    // recomputing them, new keys are raised by that much.
+    key_modifier_ += heuristic_(start);
+    start_ = start;
+    heuristic_ = alt_heuristic{landmarks_, start};
+  }
+
+  std::vector<position> changed;
+  for (position p : blocked_)
+    if (std::find(blocked.begin(), blocked.end(), p) == blocked.end())
+      changed.push_back(p);
+  for (position p : blocked)
+    if (std::find(blocked_.begin(), blocked_.end(), p) == blocked_.end())
+      changed.push_back(p);
+  blocked_ = std::move(blocked);
+
+  for (position p : changed) {
+    update(p);
+    for (position n : map_->adjacent(p))
+      update(n);
+  }
+
+  if (queue_.size() > 4 * queued_ + 1024)
+    rebuild_queue();
+
+  if (!compute_shortest_path(stop) || g(start_) == infinity)
+    return {};
+
+  path<> result{start_};
+  position current = start_;
+  while (current != goal_) {
+    position best = current;
+    unsigned best_g = infinity;
+    for (position n : map_->adjacent(current))
+      if (passable(n) && g(n) < best_g) {
+        best = n;
+        best_g = g(n);
+      }
+
+    if (best_g == infinity || result.size() > g(start_))
+      return {};
+
+    result.push_back(best);
+    current = best;
+  }
+
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+std::size_t
+d_star_lite::memory() const {
+  return nodes_.memory() + queue_.size() * sizeof(entry)
+    + blocked_.capacity() * sizeof(position);
+}
+
+auto
+d_star_lite::at(position p) -> node& {
+  if (node* n = nodes_.find(p))
+    return *n;
+
+  nodes_.insert(p, node{});
+  return *nodes_.find(p);
+}
+
+unsigned
+d_star_lite::g(position p) const {
+  node const* n = nodes_.find(p);
+  return n ? n->g : infinity;
+}
+
+bool
+d_star_lite::passable(position p) const {
+  return std::find(blocked_.begin(), blocked_.end(), p) == blocked_.end();
+}
+
+auto
+d_star_lite::calculate_key(position p, node const& n) const -> key {
+  unsigned const m = std::min(n.g, n.rhs);
+  if (m == infinity)
+    return {infinity, infinity};
+  return {m + heuristic_(p) + key_modifier_, m};
+}
+
+// One step plus the distance from the best neighbour.
+unsigned
+d_star_lite::lookahead(position p) const {
+  if (!passable(p))
+    return infinity;
+
+  unsigned result = infinity;
+  for (position n : map_->adjacent(p))
+    if (passable(n) && g(n) != infinity)
+      result = std::min(result, g(n) + 1);
+
+  return result;
+}
+
+// Recompute p's rhs and put it into the queue or take it out, depending on
+// whether it's consistent.
+void
+d_star_lite::update(position p) {
+  node& n = at(p);
+  if (p != goal_)
+    n.rhs = lookahead(p);
+
+  if (n.g != n.rhs) {
+    key const k = calculate_key(p, n);
+    if (!n.queued || n.queued_key != k) {
+      if (!n.queued)
+        ++queued_;
+      n.queued = true;
+      n.queued_key = k;
+      queue_.push({k, p});
+    }
+  } else if (n.queued) {
+    n.queued = false;
+    --queued_;
+  }
+}
+
+bool
+d_star_lite::compute_shortest_path(std::atomic<bool> const& stop) {
+  while (true) {
+    bool const nonempty = prune_queue();
+    node const& start = at(start_);
+    if ((!nonempty || !(queue_.top().k < calculate_key(start_, start)))
+        && start.g == start.rhs)
+      return true;
+
+    if (!nonempty)
+      return true;
+
+    if (stop)
+      return false;
+
+    entry const top = queue_.top();
+    queue_.pop();
+
+    node& u = at(top.p);
+    key const new_key = calculate_key(top.p, u);
+    if (top.k < new_key) {
+      u.queued_key = new_key;
+      queue_.push({new_key, top.p});
+      continue;
+    }
+
+    u.queued = false;
+    --queued_;
+    ++nodes_expanded_;
+
+    if (u.g > u.rhs)
+      u.g = u.rhs;
+    else {
+      u.g = infinity;
+      update(top.p);
+    }
+
+    for (position n : map_->adjacent(top.p))
+      update(n);
+  }
+}
+
+// Drop stale entries from the top of the queue. Returns whether any entries
+// are left.
+bool
+d_star_lite::prune_queue() {
+  while (!queue_.empty()) {
+    entry const& top = queue_.top();
+    node const* n = nodes_.find(top.p);
+    if (n && n->queued && n->queued_key == top.k)
+      return true;
+    queue_.pop();
+  }
+
+  return false;
+}
+
+void
+d_star_lite::rebuild_queue() {
+  std::vector<entry> entries;
+  entries.reserve(queued_);
+  nodes_.foreach([&] (position p, node const& n) {
+    if (n.queued)
+      entries.push_back({n.queued_key, p});
+  });
+
+  queue_ = decltype(queue_)(std::greater<entry>{}, std::move(entries));
+}
@@ -0,0 +1,102 @@
+#ifndef D_STAR_LITE_HPP
+#define D_STAR_LITE_HPP
+
+#include "grid_table.hpp"
+#include "landmarks.hpp"
+#include "world.hpp"
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Incremental shortest paths to a fixed goal on the 4-connected grid: D* Lite
+// (Koenig and Likhachev, 2002). Distances to the goal are searched for
+// backwards from the goal. Besides walls, a few tiles may be blocked; when the
+// blocked tiles change or the start moves between searches, only the distances
+// affected by the change are repaired instead of searching from scratch.
+class d_star_lite {
+public:
+  d_star_lite(std::shared_ptr<::map const> m, position goal,
+              landmarks const* landmarks = nullptr);
+
+  position goal() const { return goal_; }
+  std::shared_ptr<::map const> const& map() const { return map_; }
+
+  // Shortest path from start to the goal avoiding the blocked tiles, in the
+  // format of a_star: goal first, start last. Empty if there is no path or if
+  // stop was set.
+  path<>
+  find_path(position start, std::vector<position> blocked,
+            std::atomic<bool> const& stop);
+
+  // Number of tiles expanded by the last find_path.
+  unsigned nodes_expanded() const { return nodes_expanded_; }
+
+  // Approximate number of bytes allocated.
+  std::size_t
+  memory() const;
+
+private:
+  using key = std::pair<unsigned, unsigned>;
+
+  static constexpr unsigned infinity = std::numeric_limits<unsigned>::max();
+
+  struct node {
+    unsigned g = infinity;
+    unsigned rhs = infinity;
+    key queued_key;
+    bool queued = false;
+  };
+
+  // The queue is a binary heap with lazy deletion: entries whose key no longer
+  // matches their node's are skipped.
+  struct entry {
+    key k;
+    position p;
+    bool operator > (entry const& other) const { return k > other.k; }
+  };
+
+  std::shared_ptr<::map const> map_;
+  position goal_;
+  landmarks const* landmarks_;
+  position start_;
+  alt_heuristic heuristic_;  // Lower bound on the distance from start_.
+  unsigned key_modifier_ = 0;
+  std::vector<position> blocked_;
+  grid_table<node> nodes_;
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue_;
+  std::size_t queued_ = 0;
+  unsigned nodes_expanded_ = 0;
+
+  node&
+  at(position p);
+
+  unsigned
+  g(position p) const;
+
+  bool
+  passable(position p) const;
+
+  key
+  calculate_key(position p, node const& n) const;
+
+  unsigned
+  lookahead(position p) const;
+
+  void
+  update(position p);
+
+  bool
+  compute_shortest_path(std::atomic<bool> const& stop);
+
+  bool
+  prune_queue();
+
+  void
+  rebuild_queue();
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "distance_cache.hpp"
+
+constexpr unsigned distance_table::unknown;
+
+distance_table::distance_table(std::shared_ptr<map const> m, position target)
+  : map_(std::move(m))
+  , target_(target)
+  , pages_per_row_((map_->width() + page_side - 1) / page_side)
+  , page_count_(pages_per_row_
+                * ((map_->height() + page_side - 1) / page_side))
+  , pages_(new std::atomic<page*>[page_count_]())
+{
+  if (map_->passable(target)) {
+    insert(target, 0);
+    queue_.push_back(target);
+  }
+  update_memory();
+}
+
+boost::optional<unsigned>
+distance_table::distance(position p, unsigned& expanded) {
+  // Once the search has run out, every entry it will ever set is visible.
+  bool const exhausted = exhausted_.load(std::memory_order_acquire);
+  std::atomic<unsigned>* entry = find(p);
+  if (entry)
+    return entry->load(std::memory_order_relaxed);
+  if (exhausted)
+    return boost::none;
+
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  entry = find(p);
+  while (!entry && queue_head_ < queue_.size()) {
+    position const current = queue_[queue_head_++];
+    unsigned const d = find(current)->load(std::memory_order_relaxed) + 1;
+    ++expanded;
+
+    for (position n : map_->adjacent(current))
+      if (!find(n)) {
+        insert(n, d);
+        queue_.push_back(n);
+      }
+
+    entry = find(p);
+  }
+
+  if (queue_head_ == queue_.size())
+    exhausted_.store(true, std::memory_order_release);
+  update_memory();
+
+  if (entry)
+    return entry->load(std::memory_order_relaxed);
+  else
+    return boost::none;
+}
+
+std::size_t
+distance_table::memory() const {
+  return memory_.load(std::memory_order_relaxed);
+}
+
+std::atomic<unsigned>*
+distance_table::find(position p) const {
+  page* const pg =
+    pages_[(p.y / page_side) * pages_per_row_ + p.x / page_side]
+    .load(std::memory_order_acquire);
+  if (!pg)
+    return nullptr;
+
+  std::atomic<unsigned>& entry =
+    (*pg)[(p.y % page_side) * page_side + p.x % page_side];
+  return entry.load(std::memory_order_acquire) != unknown ? &entry : nullptr;
+}
+
+void
+distance_table::insert(position p, unsigned d) {
+  std::atomic<page*>& slot =
+    pages_[(p.y / page_side) * pages_per_row_ + p.x / page_side];
+  page* pg = slot.load(std::memory_order_relaxed);
+  if (!pg) {
+    allocated_.push_back(std::make_unique<page>());
+    pg = allocated_.back().get();
+    for (std::atomic<unsigned>& entry : *pg)
+      entry.store(unknown, std::memory_order_relaxed);
+    slot.store(pg, std::memory_order_release);
+  }
+
+  (*pg)[(p.y % page_side) * page_side + p.x % page_side]
+    .store(d, std::memory_order_release);
+}
+
+void
+distance_table::update_memory() {
+  memory_.store(page_count_ * sizeof(std::atomic<page*>)
+                + allocated_.capacity() * sizeof(std::unique_ptr<page>)
+                + allocated_.size() * sizeof(page)
+                + queue_.capacity() * sizeof(position),
+                std::memory_order_relaxed);
+}
+
+constexpr std::size_t distance_cache::default_memory_budget;
+
+distance_cache::distance_cache(std::shared_ptr<::map const> m,
+                               std::size_t memory_budget)
+  : map_(std::move(m))
+  , memory_budget_(memory_budget)
+{ }
+
+std::shared_ptr<distance_cache>
+distance_cache::for_map(std::shared_ptr<::map const> const& m) {
+  static std::mutex mutex;
+  static std::unordered_map<::map const*, std::weak_ptr<distance_cache>>
+    caches;
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  for (auto it = caches.begin(); it != caches.end(); )
+    if (it->second.expired())
+      it = caches.erase(it);
+    else
+      ++it;
+
+  // A live cache keeps its map alive, so the address can't have been reused
+  // by another map.
+  std::weak_ptr<distance_cache>& entry = caches[m.get()];
+  std::shared_ptr<distance_cache> result = entry.lock();
+  if (!result) {
+    result = std::make_shared<distance_cache>(m);
+    entry = result;
+  }
+
+  return result;
+}
+
+std::shared_ptr<distance_table>
+distance_cache::get(position target) {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  auto it = index_.find(target);
+  if (it != index_.end()) {
+    tables_.splice(tables_.begin(), tables_, it->second);
+    entry& e = tables_.front();
+    std::size_t const memory = e.table->memory();
+    total_memory_ += memory - e.memory;
+    e.memory = memory;
+  } else {
+    auto table = std::make_shared<distance_table>(map_, target);
+    std::size_t const memory = table->memory();
+    tables_.push_front({std::move(table), memory});
+    index_.insert({target, tables_.begin()});
+    total_memory_ += memory;
+  }
+
+  evict();
+  return tables_.front().table;
+}
+
+void
+distance_cache::evict() {
+  while (total_memory_ > memory_budget_ && tables_.size() > 1) {
+    total_memory_ -= tables_.back().memory;
+    index_.erase(tables_.back().table->target());
+    tables_.pop_back();
+  }
+}
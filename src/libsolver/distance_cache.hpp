@@ -0,0 +1,115 @@
+#ifndef DISTANCE_CACHE_HPP
+#define DISTANCE_CACHE_HPP
+
+#include "world.hpp"
+
+#include <boost/optional.hpp>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// True distances to a target tile over static walls, found by breadth-first
+// search backwards from the target. The search is only run as far as the
+// queries so far have needed, and resumes when a query needs more. Safe to use
+// from several threads: distances already found are read without locking, and
+// only a query that needs the search resumed waits for the lock.
+class distance_table {
+public:
+  distance_table(std::shared_ptr<map const> m, position target);
+
+  position target() const { return target_; }
+
+  // Distance from p to the target, or none if the target is unreachable from
+  // p. expanded is increased by the number of tiles expanded to answer.
+  boost::optional<unsigned>
+  distance(position p, unsigned& expanded);
+
+  // Approximate number of bytes allocated by the table.
+  std::size_t
+  memory() const;
+
+private:
+  // Like grid_table, the map is split into pages of 16×16 tiles allocated when
+  // the search first reaches them. A page is published only once filled in, and
+  // entries once set never change.
+  static constexpr map::coord_type page_side = 16;
+  static constexpr unsigned page_size = page_side * page_side;
+  static constexpr unsigned unknown = -1;
+
+  using page = std::array<std::atomic<unsigned>, page_size>;
+
+  std::mutex mutex_;
+  std::shared_ptr<map const> map_;
+  position target_;
+  map::coord_type pages_per_row_;
+  std::size_t page_count_;
+  std::unique_ptr<std::atomic<page*>[]> pages_;
+  std::vector<std::unique_ptr<page>> allocated_;  // Guarded by mutex_.
+  std::vector<position> queue_;                    // Likewise.
+  std::size_t queue_head_ = 0;                     // Likewise.
+  std::atomic<std::size_t> memory_{0};
+  std::atomic<bool> exhausted_{false};
+
+  std::atomic<unsigned>*
+  find(position p) const;
+
+  // Only with mutex_ held.
+  void
+  insert(position p, unsigned d);
+
+  void
+  update_memory();
+};
+
+// Distance tables for the targets on one map, shared by everyone searching
+// that map. Once the tables take more than the memory budget, the least
+// recently used ones are dropped from the cache; tables still held by someone
+// live on until released. Safe to use from several threads.
+//
+// Tables keep growing while they are used, so the cache's total is only
+// brought up to date for a table when it is fetched again. That keeps a hit
+// from having to look at every table.
+class distance_cache {
+public:
+  static constexpr std::size_t default_memory_budget = 128 << 20;
+
+  explicit
+  distance_cache(std::shared_ptr<::map const> m,
+                 std::size_t memory_budget = default_memory_budget);
+
+  // The cache shared by all users of the given map.
+  static std::shared_ptr<distance_cache>
+  for_map(std::shared_ptr<::map const> const& m);
+
+  std::shared_ptr<::map const> const&
+  map() const { return map_; }
+
+  // Get the table for the given target, making a new one if needed.
+  std::shared_ptr<distance_table>
+  get(position target);
+
+private:
+  struct entry {
+    std::shared_ptr<distance_table> table;
+    std::size_t memory;  // What the table counts towards total_memory_.
+  };
+
+  using lru_list = std::list<entry>;
+
+  std::mutex mutex_;
+  std::shared_ptr<::map const> map_;
+  std::size_t memory_budget_;
+  std::size_t total_memory_ = 0;
+  lru_list tables_;  // Most recently used first.
+  std::unordered_map<position, lru_list::iterator> index_;
+
+  void
+  evict();
+};
+
+#endif
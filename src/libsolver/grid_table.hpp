@@ -0,0 +1,178 @@
+#ifndef GRID_TABLE_HPP
+#define GRID_TABLE_HPP
+
+#include "world.hpp"
+
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// Table from the positions of a map to values. The map is split into pages of
+// 16×16 tiles which are allocated when first written to, so a table costs
+// memory in proportion to the area it was used for. Clearing takes constant
+// time: each page remembers the generation it was last written in, and pages
+// from earlier generations read as empty.
+//
+// prepare has to be called before the table is used.
+template <typename Value>
+class grid_table {
+public:
+  void
+  prepare(map const& m) {
+    width_ = m.width();
+    height_ = m.height();
+    pages_per_row_ = (width_ + page_side - 1) / page_side;
+    pages_.clear();
+    allocated_pages_ = 0;
+    pages_.resize(pages_per_row_ * ((height_ + page_side - 1) / page_side));
+    clear();
+  }
+
+  void
+  clear() {
+    if (++generation_ == 0) {
+      // Wrapped around; old pages could be mistaken for current ones.
+      for (auto& page : pages_)
+        if (page)
+          page->generation = 0;
+      generation_ = 1;
+    }
+  }
+
+  Value*
+  find(position p) {
+    page* const pg = current_page(p);
+    return pg && pg->present[offset(p)] ? &pg->values[offset(p)] : nullptr;
+  }
+
+  Value const*
+  find(position p) const {
+    return const_cast<grid_table*>(this)->find(p);
+  }
+
+  bool
+  count(position p) const { return find(p) != nullptr; }
+
+  // Does nothing if p is already in the table.
+  void
+  insert(position p, Value v) {
+    page& pg = writable_page(p);
+    if (!pg.present[offset(p)]) {
+      pg.present[offset(p)] = true;
+      pg.values[offset(p)] = std::move(v);
+    }
+  }
+
+  void
+  erase(position p) {
+    if (page* const pg = current_page(p))
+      pg->present[offset(p)] = false;
+  }
+
+  // Empty the table and free its pages.
+  void
+  release() {
+    for (auto& page : pages_)
+      page.reset();
+    allocated_pages_ = 0;
+  }
+
+  // Approximate number of bytes allocated by the table.
+  std::size_t
+  memory() const {
+    return pages_.capacity() * sizeof(std::unique_ptr<page>)
+      + allocated_pages_ * sizeof(page);
+  }
+
+  // Call f(position, value) for each entry.
+  template <typename F>
+  void
+  foreach(F f) const {
+    for (std::size_t i = 0; i < pages_.size(); ++i) {
+      page const* const pg = pages_[i].get();
+      if (!pg || pg->generation != generation_)
+        continue;
+
+      map::coord_type const page_x = (i % pages_per_row_) * page_side;
+      map::coord_type const page_y = (i / pages_per_row_) * page_side;
+      for (unsigned j = 0; j < page_size; ++j)
+        if (pg->present[j])
+          f(position{page_x + (map::coord_type) (j % page_side),
+                     page_y + (map::coord_type) (j / page_side)},
+            pg->values[j]);
+    }
+  }
+
+private:
+  static constexpr map::coord_type page_side = 16;
+  static constexpr unsigned page_size = page_side * page_side;
+
+  struct page {
+    unsigned generation = 0;
+    std::bitset<page_size> present;
+    std::array<Value, page_size> values;
+  };
+
+  std::vector<std::unique_ptr<page>> pages_;
+  map::coord_type width_ = 0;
+  map::coord_type height_ = 0;
+  map::coord_type pages_per_row_ = 0;
+  std::size_t allocated_pages_ = 0;
+  unsigned generation_ = 0;
+
+  std::size_t
+  page_index(position p) const {
+    assert(p.x >= 0 && p.y >= 0 && p.x < width_ && p.y < height_);
+    return (p.y / page_side) * pages_per_row_ + p.x / page_side;
+  }
+
+  static unsigned
+  offset(position p) {
+    return (p.y % page_side) * page_side + p.x % page_side;
+  }
+
+  page*
+  current_page(position p) {
+    page* const pg = pages_[page_index(p)].get();
+    return pg && pg->generation == generation_ ? pg : nullptr;
+  }
+
+  page&
+  writable_page(position p) {
+    std::unique_ptr<page>& pg = pages_[page_index(p)];
+    if (!pg) {
+      pg = std::make_unique<page>();
+      ++allocated_pages_;
+    }
+
+    if (pg->generation != generation_) {
+      pg->generation = generation_;
+      pg->present.reset();
+    }
+
+    return *pg;
+  }
+};
+
+// Set of positions of a map, with the same properties as grid_table.
+class grid_set {
+public:
+  void prepare(map const& m)  { table_.prepare(m); }
+  void clear()                { table_.clear(); }
+  void insert(position p)     { table_.insert(p, {}); }
+  bool count(position p) const { return table_.count(p); }
+
+  template <typename F>
+  void
+  foreach(F f) const {
+    table_.foreach([&] (position p, empty) { f(p); });
+  }
+
+private:
+  struct empty { };
+  grid_table<empty> table_;
+};
+
+#endif
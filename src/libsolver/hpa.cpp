@@ -0,0 +1,155 @@
+#include "hpa.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+constexpr unsigned cluster_hierarchy::default_cluster_size;
+
+namespace {
+
+// Entrances shorter than this are crossed in the middle, longer ones at both
+// ends.
+constexpr unsigned long_entrance = 6;
+
+struct transition {
+  position inside;
+  position outside;
+};
+
+// Find the transitions across the border between the tiles a and a + step,
+// for a going along the border in the direction of along, for length tiles.
+void
+add_transitions(map const& m, position a, position step, position along,
+                unsigned length, std::vector<transition>& result) {
+  auto crossable = [&] (unsigned i) {
+    position const p{a.x + along.x * (int) i, a.y + along.y * (int) i};
+    return m.passable(p) && m.passable({p.x + step.x, p.y + step.y});
+  };
+
+  auto add = [&] (unsigned i) {
+    position const p{a.x + along.x * (int) i, a.y + along.y * (int) i};
+    result.push_back({p, {p.x + step.x, p.y + step.y}});
+  };
+
+  unsigned i = 0;
+  while (i < length) {
+    if (!crossable(i)) {
+      ++i;
+      continue;
+    }
+
+    unsigned const begin = i;
+    while (i < length && crossable(i))
+      ++i;
+
+    if (i - begin < long_entrance)
+      add(begin + (i - begin) / 2);
+    else {
+      add(begin);
+      add(i - 1);
+    }
+  }
+}
+
+}
+
+cluster_hierarchy::cluster_hierarchy(std::shared_ptr<::map const> m,
+                                     unsigned cluster_size)
+  : map_(std::move(m))
+  , cluster_size_(cluster_size)
+{
+  if (cluster_size_ < 2)
+    throw std::runtime_error{"Clusters must be at least 2 tiles wide"};
+
+  ::map const& mp = *map_;
+  int const size = cluster_size_;
+  clusters_per_row_ = (mp.width() + size - 1) / size;
+  unsigned const clusters_per_column = (mp.height() + size - 1) / size;
+  unsigned const clusters = clusters_per_row_ * clusters_per_column;
+
+  std::vector<transition> transitions;
+  for (int y = 0; y < mp.height(); y += size)
+    for (int x = 0; x < mp.width(); x += size) {
+      unsigned const width = std::min(size, mp.width() - x);
+      unsigned const height = std::min(size, mp.height() - y);
+
+      // Borders with the clusters to the right and below.
+      if (x + size < mp.width())
+        add_transitions(mp, {x + size - 1, y}, {1, 0}, {0, 1}, height,
+                        transitions);
+      if (y + size < mp.height())
+        add_transitions(mp, {x, y + size - 1}, {0, 1}, {1, 0}, width,
+                        transitions);
+    }
+
+  for (transition const& t : transitions) {
+    positions_.push_back(t.inside);
+    positions_.push_back(t.outside);
+  }
+
+  std::sort(positions_.begin(), positions_.end(),
+            [&] (position a, position b) {
+              return std::make_tuple(cluster(a), a.y, a.x)
+                   < std::make_tuple(cluster(b), b.y, b.x);
+            });
+  positions_.erase(std::unique(positions_.begin(), positions_.end()),
+                   positions_.end());
+
+  std::unordered_map<position, unsigned> index;
+  for (unsigned n = 0; n < positions_.size(); ++n)
+    index[positions_[n]] = n;
+
+  cluster_offsets_.assign(clusters + 1, 0);
+  for (position p : positions_)
+    ++cluster_offsets_[cluster(p) + 1];
+  for (unsigned c = 0; c < clusters; ++c)
+    cluster_offsets_[c + 1] += cluster_offsets_[c];
+
+  std::vector<std::vector<edge>> adjacency(positions_.size());
+  for (transition const& t : transitions) {
+    adjacency[index[t.inside]].push_back({index[t.outside], 1});
+    adjacency[index[t.outside]].push_back({index[t.inside], 1});
+  }
+
+  // Distances within each cluster by breadth-first search from each node.
+  std::vector<unsigned> distance(size * size);
+  std::vector<position> queue;
+  for (unsigned c = 0; c < clusters; ++c) {
+    int const x0 = (c % clusters_per_row_) * size;
+    int const y0 = (c / clusters_per_row_) * size;
+    auto local = [&] (position p) { return (p.y - y0) * size + (p.x - x0); };
+
+    for (unsigned from : cluster_nodes(c)) {
+      std::fill(distance.begin(), distance.end(), infinity);
+      queue.assign(1, positions_[from]);
+      distance[local(positions_[from])] = 0;
+
+      for (std::size_t i = 0; i < queue.size(); ++i)
+        for (position n : mp.adjacent(queue[i]))
+          if (cluster(n) == c && distance[local(n)] == infinity) {
+            distance[local(n)] = distance[local(queue[i])] + 1;
+            queue.push_back(n);
+          }
+
+      for (unsigned to : cluster_nodes(c))
+        if (to != from && distance[local(positions_[to])] != infinity)
+          adjacency[from].push_back({to, distance[local(positions_[to])]});
+    }
+  }
+
+  edge_offsets_.push_back(0);
+  for (std::vector<edge> const& edges : adjacency) {
+    edges_.insert(edges_.end(), edges.begin(), edges.end());
+    edge_offsets_.push_back(edges_.size());
+  }
+}
+
+std::size_t
+cluster_hierarchy::memory() const {
+  return positions_.capacity() * sizeof(position)
+    + cluster_offsets_.capacity() * sizeof(unsigned)
+    + edge_offsets_.capacity() * sizeof(unsigned)
+    + edges_.capacity() * sizeof(edge);
+}
@@ -0,0 +1,334 @@
+#ifndef HPA_HPP
+#define HPA_HPP
+
+#include "a_star.hpp"
+#include "grid_table.hpp"
+#include "world.hpp"
+
+#include <boost/range/irange.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <vector>
+
+// Abstraction of a map for hierarchical path-finding (HPA*, Botea, Müller and
+// Schaeffer, 2004). The map is split into square clusters. Where two
+// neighbouring clusters touch, each maximal run of passable tile pairs across
+// the border is an entrance, crossed by one transition in its middle or, if the
+// run is long, by two at its ends. The tiles of the transitions are the nodes
+// of an abstract graph; its edges are the steps across borders and the
+// distances between the nodes of each cluster within the cluster.
+//
+// Only walls are considered, so the abstraction is built once per map.
+class cluster_hierarchy {
+public:
+  static constexpr unsigned default_cluster_size = 16;
+
+  struct edge {
+    unsigned to;
+    unsigned cost;
+  };
+
+  using node_range = boost::integer_range<unsigned>;
+  using edge_range = boost::iterator_range<edge const*>;
+
+  explicit
+  cluster_hierarchy(std::shared_ptr<::map const> m,
+                    unsigned cluster_size = default_cluster_size);
+
+  std::shared_ptr<::map const> const& map() const { return map_; }
+  unsigned cluster_size() const { return cluster_size_; }
+
+  unsigned
+  cluster(position p) const {
+    return (p.y / cluster_size_) * clusters_per_row_ + p.x / cluster_size_;
+  }
+
+  unsigned node_count() const { return positions_.size(); }
+  position node_position(unsigned n) const { return positions_[n]; }
+
+  // The abstract nodes in the given cluster.
+  node_range
+  cluster_nodes(unsigned cluster) const {
+    return boost::irange(cluster_offsets_[cluster],
+                         cluster_offsets_[cluster + 1]);
+  }
+
+  edge_range
+  edges(unsigned n) const {
+    return {edges_.data() + edge_offsets_[n],
+            edges_.data() + edge_offsets_[n + 1]};
+  }
+
+  // Number of bytes taken by the abstract graph.
+  std::size_t
+  memory() const;
+
+private:
+  std::shared_ptr<::map const> map_;
+  unsigned cluster_size_;
+  unsigned clusters_per_row_;
+  std::vector<position> positions_;        // Sorted by cluster.
+  std::vector<unsigned> cluster_offsets_;  // Into positions_, per cluster.
+  std::vector<unsigned> edge_offsets_;     // Into edges_, per node.
+  std::vector<edge> edges_;
+};
+
+// The hierarchy if it's for the world's map, null otherwise.
+inline cluster_hierarchy const*
+hierarchy_for(std::shared_ptr<cluster_hierarchy const> const& h,
+              world const& w) {
+  return h && h->map() == w.map() ? h.get() : nullptr;
+}
+
+// Path queries on a cluster_hierarchy. The start and goal are connected to the
+// abstract nodes of their clusters, the abstract graph is searched, and each
+// abstract edge is refined into single steps by a search within its cluster.
+//
+// Passable is checked when connecting the start and goal and when refining,
+// with the same signature as for a_star; it must not depend on the time. The
+// abstract graph only knows about walls, so a refined edge may turn out to be
+// blocked. Then no path is returned and the caller should search the full map.
+// The path found is usually a few percent longer than the shortest.
+template <typename Passable>
+class hierarchical_search {
+public:
+  // Path from `from` to `to` in the format of a_star: goal first, start last.
+  // The abstract search is guided by distance(position, world).
+  template <typename Distance>
+  path<>
+  find_path(cluster_hierarchy const& h, position from, position to,
+            world const& w, std::atomic<bool>& stop, Passable passable,
+            Distance distance);
+
+  unsigned nodes_expanded() const { return expanded_; }
+
+private:
+  struct in_cluster {
+    cluster_hierarchy const* hierarchy;
+    unsigned cluster;
+    Passable* passable;
+
+    bool operator () (position where, position from, world const& w,
+                      unsigned distance) const {
+      return hierarchy->cluster(where) == cluster
+        && (*passable)(where, from, w, distance);
+    }
+  };
+
+  using local_search_type = a_star<
+    position, position_successors, in_cluster,
+    manhattan_distance_heuristic, unitary_step_cost, space_coordinate<>,
+    no_distance_storage, always_close<position>, grid_open_set,
+    radix_queue, grid_closed_set
+  >;
+
+  struct entry {
+    double f;
+    unsigned node;
+    bool operator > (entry const& other) const { return f > other.f; }
+  };
+
+  std::shared_ptr<map const> map_;
+  grid_table<unsigned> distances_;
+  std::vector<position> queue_;
+  std::vector<double> g_;
+  std::vector<unsigned> parent_;
+  std::vector<unsigned> visited_;  // Generation in which g_ was set.
+  std::vector<bool> closed_;
+  std::vector<unsigned> goal_distance_;
+  std::vector<cluster_hierarchy::edge> start_edges_;
+  unsigned generation_ = 0;
+  unsigned expanded_ = 0;
+  local_search_type local_search_;
+
+  void
+  breadth_first(cluster_hierarchy const& h, position from, world const& w,
+                Passable& passable);
+
+  bool
+  refine(cluster_hierarchy const& h, position from, position to,
+         world const& w, std::atomic<bool>& stop, Passable& passable,
+         path<>& result);
+};
+
+template <typename Passable>
+template <typename Distance>
+path<>
+hierarchical_search<Passable>::find_path(
+  cluster_hierarchy const& h, position from, position to, world const& w,
+  std::atomic<bool>& stop, Passable passable, Distance distance
+) {
+  expanded_ = 0;
+  if (map_ != w.map()) {
+    map_ = w.map();
+    distances_.prepare(*map_);
+  }
+
+  unsigned const node_count = h.node_count();
+  unsigned const start = node_count;
+  unsigned const goal = node_count + 1;
+  g_.resize(node_count + 2);
+  parent_.resize(node_count + 2);
+  visited_.resize(node_count + 2);
+  closed_.assign(node_count + 2, false);
+  goal_distance_.resize(node_count);
+  if (++generation_ == 0) {
+    std::fill(visited_.begin(), visited_.end(), 0);
+    generation_ = 1;
+  }
+
+  // Distances from the goal to the nodes of its cluster.
+  breadth_first(h, to, w, passable);
+  unsigned const goal_cluster = h.cluster(to);
+  for (unsigned n : h.cluster_nodes(goal_cluster)) {
+    unsigned const* d = distances_.find(h.node_position(n));
+    goal_distance_[n] = d ? *d : infinity;
+  }
+
+  // Edges from the start to the nodes of its cluster and to the goal if it's
+  // in the same cluster.
+  breadth_first(h, from, w, passable);
+  start_edges_.clear();
+  for (unsigned n : h.cluster_nodes(h.cluster(from)))
+    if (unsigned const* d = distances_.find(h.node_position(n)))
+      start_edges_.push_back({n, *d});
+  if (unsigned const* d = distances_.find(to))
+    start_edges_.push_back({goal, *d});
+
+  auto position_of = [&] (unsigned n) {
+    return n == start ? from : n == goal ? to : h.node_position(n);
+  };
+
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> open;
+  g_[start] = 0.0;
+  visited_[start] = generation_;
+  open.push({distance(from, w), start});
+
+  auto relax = [&] (unsigned u, unsigned v, unsigned cost) {
+    if (closed_[v])
+      return;
+    double const g = g_[u] + cost;
+    if (visited_[v] == generation_ && g_[v] <= g)
+      return;
+
+    // Transitions blocked by dynamic obstacles are left out right away, rather
+    // than failing the refinement.
+    if (v != goal && !passable(position_of(v), position_of(u), w, g))
+      return;
+
+    g_[v] = g;
+    parent_[v] = u;
+    visited_[v] = generation_;
+    open.push({g + (v == goal ? 0.0 : distance(position_of(v), w)), v});
+  };
+
+  bool found = false;
+  while (!open.empty()) {
+    if (stop)
+      return {};
+
+    unsigned const u = open.top().node;
+    open.pop();
+    if (closed_[u])
+      continue;
+    closed_[u] = true;
+    ++expanded_;
+
+    if (u == goal) {
+      found = true;
+      break;
+    }
+
+    if (u == start) {
+      for (cluster_hierarchy::edge e : start_edges_)
+        relax(u, e.to, e.cost);
+      continue;
+    }
+
+    for (cluster_hierarchy::edge e : h.edges(u))
+      relax(u, e.to, e.cost);
+
+    if (h.cluster(h.node_position(u)) == goal_cluster
+        && goal_distance_[u] != infinity)
+      relax(u, goal, goal_distance_[u]);
+  }
+
+  if (!found)
+    return {};
+
+  std::vector<position> waypoints;
+  for (unsigned n = goal; n != start; n = parent_[n])
+    waypoints.push_back(position_of(n));
+  waypoints.push_back(from);
+
+  path<> result{from};
+  for (auto p = waypoints.rbegin(); std::next(p) != waypoints.rend(); ++p)
+    if (!refine(h, *p, *std::next(p), w, stop, passable, result))
+      return {};
+
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+// Fill distances_ with the distances from `from` to the passable tiles of its
+// cluster.
+template <typename Passable>
+void
+hierarchical_search<Passable>::breadth_first(
+  cluster_hierarchy const& h, position from, world const& w,
+  Passable& passable
+) {
+  unsigned const cluster = h.cluster(from);
+  distances_.clear();
+  distances_.insert(from, 0);
+  queue_.clear();
+  queue_.push_back(from);
+
+  for (std::size_t i = 0; i < queue_.size(); ++i) {
+    position const current = queue_[i];
+    unsigned const d = *distances_.find(current);
+    ++expanded_;
+
+    for (position n : w.map()->adjacent(current))
+      if (h.cluster(n) == cluster && !distances_.count(n)
+          && passable(n, current, w, d + 1)) {
+        distances_.insert(n, d + 1);
+        queue_.push_back(n);
+      }
+  }
+}
+
+// Append the steps from `from` to `to` to result, which ends with `from`.
+template <typename Passable>
+bool
+hierarchical_search<Passable>::refine(
+  cluster_hierarchy const& h, position from, position to, world const& w,
+  std::atomic<bool>& stop, Passable& passable, path<>& result
+) {
+  if (h.cluster(from) != h.cluster(to)) {
+    // A step across a border.
+    if (!passable(to, from, w, 1))
+      return false;
+    result.push_back(to);
+    return true;
+  }
+
+  local_search_.reset(
+    from, to, w, stop, manhattan_distance_heuristic{to}, unitary_step_cost{},
+    in_cluster{&h, h.cluster(from), &passable}
+  );
+  path<> const segment = local_search_.find_path(w);
+  expanded_ += local_search_.nodes_expanded();
+  if (segment.empty())
+    return false;
+
+  result.insert(result.end(), std::next(segment.rbegin()), segment.rend());
+  return true;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#include "jps.hpp"
+
+#include <cassert>
+
+path<>
+expand_jumps(path<> const& jumps) {
+  path<> result;
+  if (jumps.empty())
+    return result;
+
+  result.push_back(jumps.front());
+  for (std::size_t i = 1; i < jumps.size(); ++i) {
+    position p = jumps[i - 1];
+    position const to = jumps[i];
+    assert(p.x == to.x || p.y == to.y);
+
+    while (p != to) {
+      p.x += (to.x > p.x) - (to.x < p.x);
+      p.y += (to.y > p.y) - (to.y < p.y);
+      result.push_back(p);
+    }
+  }
+
+  return result;
+}
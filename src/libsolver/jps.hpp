@@ -0,0 +1,110 @@
+#ifndef JPS_HPP
+#define JPS_HPP
+
+#include "world.hpp"
+
+#include <boost/optional.hpp>
+
+// Successors policy for a_star implementing Jump Point Search on the
+// 4-connected grid. Of all equally long paths, only the canonical ones are
+// searched: those that take vertical steps as early as possible. So a
+// horizontal step may be followed by a vertical one only if the vertical step
+// couldn't have been taken first because the tile it'd go through is blocked.
+// Instead of single steps, successors are the jump points along straight lines
+// where a canonical path may turn, or the goal.
+//
+// Passability must be static for the duration of the search: a tile is
+// passable if it's not a wall and passable(position, world) holds. Steps have
+// to have uniform cost; use manhattan_step_cost so that a jump costs its
+// length. The path found consists of jump points only; expand_jumps turns it
+// into single steps.
+template <typename Passable>
+class jps_successors {
+public:
+  jps_successors() = default;
+
+  jps_successors(position goal, Passable passable)
+    : goal_(goal)
+    , passable_(std::move(passable))
+  { }
+
+  template <typename F>
+  void
+  visit(position p, position const* parent, world const& w, F f) {
+    map const& m = *w.map();
+
+    auto add = [&] (int dx, int dy) {
+      if (boost::optional<position> j = jump(p, dx, dy, m, w))
+        f(*j);
+    };
+
+    if (!parent) {
+      add(0, -1);
+      add(0, 1);
+      add(1, 0);
+      add(-1, 0);
+      return;
+    }
+
+    int const dx = sign(p.x - parent->x);
+    int const dy = sign(p.y - parent->y);
+
+    if (dx != 0) {
+      add(dx, 0);
+      for (int side : {-1, 1})
+        if (forced(p, dx, side, m, w))
+          add(0, side);
+    } else {
+      add(0, dy);
+      add(1, 0);
+      add(-1, 0);
+    }
+  }
+
+private:
+  position goal_;
+  Passable passable_;
+
+  static int
+  sign(int x) { return (x > 0) - (x < 0); }
+
+  bool
+  passable(position p, map const& m, world const& w) {
+    return m.passable(p) && passable_(p, w);
+  }
+
+  // Having come to p by a horizontal step in direction dx, may the path turn
+  // vertically towards side?
+  bool
+  forced(position p, int dx, int side, map const& m, world const& w) {
+    return passable({p.x, p.y + side}, m, w)
+      && !passable({p.x - dx, p.y + side}, m, w);
+  }
+
+  // Move from p in the given direction until a jump point is found or the way
+  // is blocked.
+  boost::optional<position>
+  jump(position p, int dx, int dy, map const& m, world const& w) {
+    while (true) {
+      p = position{p.x + dx, p.y + dy};
+      if (!passable(p, m, w))
+        return boost::none;
+
+      if (p == goal_)
+        return p;
+
+      if (dx != 0) {
+        if (forced(p, dx, -1, m, w) || forced(p, dx, 1, m, w))
+          return p;
+      } else if (jump(p, 1, 0, m, w) || jump(p, -1, 0, m, w))
+        return p;
+    }
+  }
+};
+
+// Expand a path of jump points, each in a straight line from the previous one,
+// into a path of single steps.
+path<>
+expand_jumps(path<> const& jumps);
+
+#endif
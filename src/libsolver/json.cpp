@@ -0,0 +1,353 @@
+#include "json.hpp"
+
+#include <cassert>
+#include <cctype>
+#include <ostream>
+
+json_reader::json_reader(std::string text)
+  : text_(std::move(text))
+  , pos_(text_.c_str())
+{ }
+
+std::string
+json_reader::read_string() {
+  return read_scalar();
+}
+
+unsigned
+json_reader::read_unsigned() {
+  std::string const s = read_scalar();
+  if (s.empty())
+    error("Expected a number");
+
+  unsigned const max = std::numeric_limits<unsigned>::max();
+  unsigned result = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9')
+      error("Not a non-negative integer: " + s);
+
+    unsigned const digit = c - '0';
+    if (result > (max - digit) / 10)
+      error("Number too large: " + s);
+    result = result * 10 + digit;
+  }
+
+  return result;
+}
+
+double
+json_reader::read_double() {
+  std::string const s = read_scalar();
+
+  std::istringstream in{s};
+  in.imbue(std::locale::classic());
+
+  double result;
+  if (!(in >> result) || in.peek() != std::istringstream::traits_type::eof())
+    error("Not a number: " + s);
+
+  return result;
+}
+
+void
+json_reader::skip() {
+  switch (peek()) {
+  case '{':
+    read_object([&] (std::string const&) { skip(); });
+    break;
+
+  case '[':
+    read_array([&] { skip(); });
+    break;
+
+  default:
+    read_scalar();
+  }
+}
+
+void
+json_reader::expect_end() {
+  if (peek() != '\0' || pos_ != text_.c_str() + text_.size())
+    error("Trailing data after document");
+}
+
+void
+json_reader::error(std::string const& what) const {
+  throw json_error{what, line_};
+}
+
+char
+json_reader::peek() {
+  while (true)
+    switch (*pos_) {
+    case '\n':
+      ++line_;
+      // Fallthrough.
+    case ' ':
+    case '\t':
+    case '\r':
+      ++pos_;
+      break;
+
+    default:
+      return *pos_;
+    }
+}
+
+void
+json_reader::expect(char c) {
+  if (peek() != c)
+    error(std::string{"Expected '"} + c + "'");
+  ++pos_;
+}
+
+bool
+json_reader::begin_container(char open, char const* what) {
+  char const close = open == '{' ? '}' : ']';
+
+  char const c = peek();
+  if (c == open) {
+    ++pos_;
+    if (peek() == close) {
+      ++pos_;
+      return false;
+    }
+
+    return true;
+  }
+
+  if (c == '"' && pos_[1] == '"') {
+    pos_ += 2;
+    return false;
+  }
+
+  error(std::string{"Expected "} + what);
+}
+
+bool
+json_reader::next_member(char close) {
+  char const c = peek();
+  if (c == ',') {
+    ++pos_;
+    return true;
+  }
+
+  if (c == close) {
+    ++pos_;
+    return false;
+  }
+
+  error(std::string{"Expected ',' or '"} + close + "'");
+}
+
+std::string
+json_reader::read_key() {
+  if (peek() != '"')
+    error("Expected a member name");
+
+  std::string result;
+  read_string_body(result);
+  expect(':');
+  return result;
+}
+
+std::string
+json_reader::read_scalar() {
+  std::string result;
+
+  if (peek() == '"') {
+    read_string_body(result);
+    return result;
+  }
+
+  char const* const begin = pos_;
+  while (std::isalnum(static_cast<unsigned char>(*pos_))
+         || *pos_ == '-' || *pos_ == '+' || *pos_ == '.')
+    ++pos_;
+
+  if (pos_ == begin)
+    error(*pos_ ? std::string{"Unexpected '"} + *pos_ + "'"
+                : std::string{"Unexpected end of input"});
+
+  result.assign(begin, pos_);
+  return result;
+}
+
+static void
+append_utf8(std::string& out, unsigned long code) {
+  if (code < 0x80)
+    out += static_cast<char>(code);
+  else if (code < 0x800) {
+    out += static_cast<char>(0xC0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xE0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+void
+json_reader::read_string_body(std::string& out) {
+  char const* const end = text_.c_str() + text_.size();
+
+  auto hex4 = [&] {
+    unsigned long result = 0;
+    for (int i = 0; i < 4; ++i) {
+      char const c = *pos_++;
+      result *= 16;
+      if (c >= '0' && c <= '9')
+        result += c - '0';
+      else if (c >= 'a' && c <= 'f')
+        result += c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        result += c - 'A' + 10;
+      else
+        error("Invalid \\u escape");
+    }
+    return result;
+  };
+
+  assert(*pos_ == '"');
+  ++pos_;
+
+  while (true) {
+    // Copy runs of plain characters in one go.
+    char const* run = pos_;
+    while (*pos_ != '"' && *pos_ != '\\' && *pos_ != '\0') {
+      if (*pos_ == '\n')
+        ++line_;
+      ++pos_;
+    }
+    out.append(run, pos_);
+
+    if (pos_ == end)
+      error("Unterminated string");
+
+    char const c = *pos_++;
+    if (c == '"')
+      return;
+    if (c == '\0') {
+      out += '\0';
+      continue;
+    }
+
+    switch (*pos_++) {
+    case '"':  out += '"'; break;
+    case '\\': out += '\\'; break;
+    case '/':  out += '/'; break;
+    case 'b':  out += '\b'; break;
+    case 'f':  out += '\f'; break;
+    case 'n':  out += '\n'; break;
+    case 'r':  out += '\r'; break;
+    case 't':  out += '\t'; break;
+
+    case 'u': {
+      unsigned long code = hex4();
+      if (code >= 0xD800 && code < 0xDC00
+          && pos_[0] == '\\' && pos_[1] == 'u') {
+        pos_ += 2;
+        unsigned long const low = hex4();
+        if (low < 0xDC00 || low >= 0xE000)
+          error("Invalid surrogate pair");
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+      }
+      append_utf8(out, code);
+      break;
+    }
+
+    default:
+      error("Invalid escape sequence");
+    }
+  }
+}
+
+void
+json_writer::key(std::string const& k) {
+  begin_value();
+  write_string(k);
+  out_ << ": ";
+  after_key_ = true;
+}
+
+void
+json_writer::value(std::string const& v) {
+  begin_value();
+  write_string(v);
+}
+
+void
+json_writer::open(char c) {
+  begin_value();
+  out_ << c;
+  empty_.push_back(true);
+}
+
+void
+json_writer::close(char c) {
+  assert(!empty_.empty());
+  bool const was_empty = empty_.back();
+  empty_.pop_back();
+
+  if (!was_empty) {
+    out_ << '\n';
+    indent();
+  }
+
+  out_ << c;
+  if (empty_.empty())
+    out_ << '\n';
+}
+
+void
+json_writer::begin_value() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+
+  if (empty_.empty())
+    return;
+
+  if (!empty_.back())
+    out_ << ',';
+  empty_.back() = false;
+
+  out_ << '\n';
+  indent();
+}
+
+void
+json_writer::indent() {
+  for (std::size_t i = 0; i < empty_.size(); ++i)
+    out_ << "    ";
+}
+
+void
+json_writer::write_string(std::string const& s) {
+  static char const hex[] = "0123456789ABCDEF";
+
+  out_ << '"';
+  for (char c : s)
+    switch (c) {
+    case '"':  out_ << "\\\""; break;
+    case '\\': out_ << "\\\\"; break;
+    case '/':  out_ << "\\/"; break;
+    case '\b': out_ << "\\b"; break;
+    case '\f': out_ << "\\f"; break;
+    case '\n': out_ << "\\n"; break;
+    case '\r': out_ << "\\r"; break;
+    case '\t': out_ << "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        out_ << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+      else
+        out_ << c;
+    }
+  out_ << '"';
+}
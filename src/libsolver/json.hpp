@@ -0,0 +1,117 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include <iosfwd>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct json_error : std::runtime_error {
+  json_error(std::string const& what, unsigned line)
+    : std::runtime_error{"line " + std::to_string(line) + ": " + what}
+  { }
+};
+
+// Single-pass JSON reader. The document is walked with read_object and
+// read_array; the callbacks must consume exactly one value each, either by
+// reading it or by skipping it.
+//
+// The reader is lenient in the same ways as boost::property_tree, so that it
+// reads the files written by it: scalars may be given either as strings or
+// as bare literals, and an empty string stands for an empty array or object.
+class json_reader {
+public:
+  explicit json_reader(std::string text);
+
+  // Call f(key) for every member of an object.
+  template <typename F>
+  void
+  read_object(F f) {
+    if (begin_container('{', "object"))
+      do
+        f(read_key());
+      while (next_member('}'));
+  }
+
+  // Call f() for every element of an array.
+  template <typename F>
+  void
+  read_array(F f) {
+    if (begin_container('[', "array"))
+      do
+        f();
+      while (next_member(']'));
+  }
+
+  std::string read_string();
+  unsigned    read_unsigned();
+  double      read_double();
+
+  // Skip over the next value, whatever it is.
+  void skip();
+
+  // Throw if there's anything except whitespace left in the input.
+  void expect_end();
+
+  [[noreturn]] void error(std::string const& what) const;
+
+private:
+  std::string text_;
+  char const* pos_;
+  unsigned line_ = 1;
+
+  char peek();
+  void expect(char c);
+
+  bool begin_container(char open, char const* what);
+  bool next_member(char close);
+  std::string read_key();
+
+  // Read a scalar: a quoted string without escapes or a bare literal.
+  std::string read_scalar();
+  void read_string_body(std::string& out);
+};
+
+// Streaming JSON writer. Output is indented and all scalars are written as
+// strings, the same as boost::property_tree writes them.
+class json_writer {
+public:
+  explicit json_writer(std::ostream& out) : out_(out) { }
+
+  void begin_object() { open('{'); }
+  void end_object()   { close('}'); }
+  void begin_array()  { open('['); }
+  void end_array()    { close(']'); }
+
+  // Begin an object member. Must be followed by exactly one value.
+  void key(std::string const& k);
+
+  void value(std::string const& v);
+  void value(char const* v) { value(std::string{v}); }
+
+  template <typename T>
+  void
+  value(T const& v) {
+    std::ostringstream os;
+    os.imbue(std::locale::classic());
+    os.precision(std::numeric_limits<double>::max_digits10);
+    os << v;
+    value(os.str());
+  }
+
+private:
+  std::ostream& out_;
+  std::vector<bool> empty_;  // Per open container, whether it's still empty.
+  bool after_key_ = false;
+
+  void open(char c);
+  void close(char c);
+  void begin_value();
+  void indent();
+  void write_string(std::string const& s);
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "landmarks.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+landmark_selection
+landmark_selection_from_string(std::string const& name) {
+  using boost::algorithm::iequals;
+
+  if (iequals(name, "farthest"))
+    return landmark_selection::farthest;
+  else if (iequals(name, "planar"))
+    return landmark_selection::planar;
+  else if (iequals(name, "avoid"))
+    return landmark_selection::avoid;
+  else
+    throw std::runtime_error{"Unknown landmark selection: " + name};
+}
+
+namespace {
+
+using tile_distances = std::vector<unsigned>;
+
+struct search_tree {
+  tile_distances distance;
+  std::vector<std::size_t> order;   // Tiles in the order they were reached.
+  std::vector<std::size_t> parent;  // Only valid for reached tiles.
+};
+
+std::size_t
+tile_index(map const& m, position p) { return p.y * m.width() + p.x; }
+
+position
+tile_at(map const& m, std::size_t i) {
+  return {(position::coord_type) (i % m.width()),
+          (position::coord_type) (i / m.width())};
+}
+
+search_tree
+breadth_first(map const& m, position from) {
+  search_tree result;
+  result.distance.assign(m.width() * m.height(), landmarks::unreachable);
+  result.parent.resize(result.distance.size());
+
+  std::size_t const start = tile_index(m, from);
+  result.distance[start] = 0;
+  result.parent[start] = start;
+  result.order.push_back(start);
+
+  for (std::size_t i = 0; i < result.order.size(); ++i) {
+    std::size_t const current = result.order[i];
+    for (position n : m.adjacent(tile_at(m, current))) {
+      std::size_t const next = tile_index(m, n);
+      if (result.distance[next] == landmarks::unreachable) {
+        result.distance[next] = result.distance[current] + 1;
+        result.parent[next] = current;
+        result.order.push_back(next);
+      }
+    }
+  }
+
+  return result;
+}
+
+// Tiles of the largest connected part of the map.
+std::vector<std::size_t>
+largest_component(map const& m) {
+  std::vector<bool> seen(m.width() * m.height());
+  std::vector<std::size_t> component;
+  std::vector<std::size_t> result;
+
+  m.foreach_passable([&] (position p) {
+    if (seen[tile_index(m, p)])
+      return;
+
+    component.clear();
+    component.push_back(tile_index(m, p));
+    seen[tile_index(m, p)] = true;
+
+    for (std::size_t i = 0; i < component.size(); ++i)
+      for (position n : m.adjacent(tile_at(m, component[i])))
+        if (!seen[tile_index(m, n)]) {
+          seen[tile_index(m, n)] = true;
+          component.push_back(tile_index(m, n));
+        }
+
+    if (component.size() > result.size())
+      result.swap(component);
+  });
+
+  return result;
+}
+
+// Best lower bound on the distance between tiles a and b given by the
+// landmarks.
+unsigned
+lower_bound(std::vector<tile_distances> const& landmarks,
+            std::size_t a, std::size_t b) {
+  unsigned result = 0;
+  for (tile_distances const& d : landmarks)
+    result = std::max(result, d[a] > d[b] ? d[a] - d[b] : d[b] - d[a]);
+  return result;
+}
+
+// The tile of the component farthest from the nearest landmark.
+std::size_t
+farthest_tile(std::vector<std::size_t> const& component,
+              std::vector<tile_distances> const& landmarks) {
+  std::size_t result = component.front();
+  unsigned best = 0;
+  for (std::size_t t : component) {
+    unsigned nearest = landmarks::unreachable;
+    for (tile_distances const& d : landmarks)
+      nearest = std::min(nearest, d[t]);
+
+    if (nearest > best) {
+      best = nearest;
+      result = t;
+    }
+  }
+
+  return result;
+}
+
+std::vector<std::size_t>
+select_farthest(map const& m, std::vector<std::size_t> const& component,
+                unsigned count) {
+  std::vector<std::size_t> result;
+  std::vector<tile_distances> distances;
+
+  // Start from the tile farthest from an arbitrary one, which is on the edge
+  // of the component.
+  distances.push_back(breadth_first(m, tile_at(m, component.front())).distance);
+  std::size_t next = farthest_tile(component, distances);
+  distances.clear();
+
+  while (result.size() < count) {
+    result.push_back(next);
+    distances.push_back(breadth_first(m, tile_at(m, next)).distance);
+    next = farthest_tile(component, distances);
+
+    if (std::find(result.begin(), result.end(), next) != result.end())
+      break;  // Every tile is a landmark already.
+  }
+
+  return result;
+}
+
+std::vector<std::size_t>
+select_planar(map const& m, std::vector<std::size_t> const& component,
+              unsigned count) {
+  double center_x = 0.0;
+  double center_y = 0.0;
+  for (std::size_t t : component) {
+    center_x += tile_at(m, t).x;
+    center_y += tile_at(m, t).y;
+  }
+  center_x /= component.size();
+  center_y /= component.size();
+
+  double const pi = std::acos(-1.0);
+  std::vector<std::size_t> best(count, component.size());
+  std::vector<double> best_distance(count, -1.0);
+
+  for (std::size_t i = 0; i < component.size(); ++i) {
+    position const p = tile_at(m, component[i]);
+    double const dx = p.x - center_x;
+    double const dy = p.y - center_y;
+    unsigned const sector = std::min(
+      count - 1, (unsigned) ((std::atan2(dy, dx) + pi) / (2 * pi) * count)
+    );
+
+    double const d = dx * dx + dy * dy;
+    if (d > best_distance[sector]) {
+      best_distance[sector] = d;
+      best[sector] = i;
+    }
+  }
+
+  std::vector<std::size_t> result;
+  for (std::size_t i : best)
+    if (i < component.size())
+      result.push_back(component[i]);
+
+  return result;
+}
+
+std::vector<std::size_t>
+select_avoid(map const& m, std::vector<std::size_t> const& component,
+             unsigned count) {
+  std::vector<std::size_t> result;
+  std::vector<tile_distances> distances;
+  std::vector<bool> is_landmark(m.width() * m.height());
+
+  std::default_random_engine rng;
+  std::uniform_int_distribution<std::size_t> pick_root(0, component.size() - 1);
+
+  std::vector<unsigned long> size(is_landmark.size());
+  std::vector<bool> covered(is_landmark.size());
+  std::vector<std::size_t> best_child(is_landmark.size());
+  std::size_t const none = is_landmark.size();
+
+  while (result.size() < count) {
+    // Weigh each tile of a shortest-path tree by how much the current
+    // landmarks underestimate its distance from the root. A subtree's size is
+    // the total weight in it, or zero if it already contains a landmark.
+    std::size_t const root = component[pick_root(rng)];
+    search_tree const tree = breadth_first(m, tile_at(m, root));
+
+    for (std::size_t t : tree.order) {
+      size[t] = 0;
+      covered[t] = is_landmark[t];
+      best_child[t] = none;
+    }
+
+    for (auto t = tree.order.rbegin(); t != tree.order.rend(); ++t) {
+      if (!covered[*t])
+        size[*t] += tree.distance[*t] - lower_bound(distances, root, *t);
+      else
+        size[*t] = 0;
+
+      std::size_t const parent = tree.parent[*t];
+      if (parent == *t)
+        continue;
+
+      if (covered[*t])
+        covered[parent] = true;
+      else {
+        size[parent] += size[*t];
+        if (best_child[parent] == none || size[*t] > size[best_child[parent]])
+          best_child[parent] = *t;
+      }
+    }
+
+    std::size_t next = root;
+    for (std::size_t t : tree.order)
+      if (size[t] > size[next])
+        next = t;
+
+    if (size[next] == 0)
+      break;  // The landmarks are exact everywhere.
+
+    while (best_child[next] != none)
+      next = best_child[next];
+
+    result.push_back(next);
+    is_landmark[next] = true;
+    distances.push_back(breadth_first(m, tile_at(m, next)).distance);
+  }
+
+  return result;
+}
+
+}
+
+constexpr unsigned landmarks::max_count;
+constexpr unsigned landmarks::unreachable;
+
+landmarks::landmarks(std::shared_ptr<::map const> m, unsigned count,
+                     landmark_selection selection)
+  : map_(std::move(m))
+{
+  if (count > max_count)
+    throw std::runtime_error{
+      "Too many landmarks; at most " + std::to_string(max_count) + " allowed"
+    };
+
+  std::vector<std::size_t> const component = largest_component(*map_);
+  if (component.empty() || count == 0)
+    return;
+
+  std::vector<std::size_t> selected;
+  switch (selection) {
+  case landmark_selection::farthest:
+    selected = select_farthest(*map_, component, count);
+    break;
+  case landmark_selection::planar:
+    selected = select_planar(*map_, component, count);
+    break;
+  case landmark_selection::avoid:
+    selected = select_avoid(*map_, component, count);
+    break;
+  }
+
+  std::size_t const tiles = map_->width() * map_->height();
+  distances_.resize(tiles * selected.size());
+  for (std::size_t i = 0; i < selected.size(); ++i) {
+    positions_.push_back(tile_at(*map_, selected[i]));
+
+    tile_distances const d = breadth_first(*map_, positions_.back()).distance;
+    for (std::size_t t = 0; t < tiles; ++t)
+      distances_[t * selected.size() + i] = d[t];
+  }
+}
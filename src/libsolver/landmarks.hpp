@@ -0,0 +1,104 @@
+#ifndef LANDMARKS_HPP
+#define LANDMARKS_HPP
+
+#include "world.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How to place landmarks on a map.
+enum class landmark_selection {
+  farthest,  // Each landmark as far as possible from the previous ones.
+  planar,    // Around the edge of the map, one in each angular sector.
+  avoid      // Where the current landmarks give the worst lower bounds.
+};
+
+landmark_selection
+landmark_selection_from_string(std::string const&);  // Throws runtime_error.
+
+// Distances from a few landmark tiles to every tile of a map. By the triangle
+// inequality, |d(L, a) - d(L, b)| is a lower bound on the distance between a
+// and b for any landmark L. The landmarks are all placed in the largest
+// connected part of the map.
+class landmarks {
+public:
+  static constexpr unsigned max_count = 16;
+  static constexpr unsigned unreachable = std::numeric_limits<unsigned>::max();
+
+  landmarks(std::shared_ptr<::map const> m, unsigned count,
+            landmark_selection selection);
+
+  std::shared_ptr<::map const> const& map() const { return map_; }
+  unsigned count() const { return positions_.size(); }
+  std::vector<position> const& positions() const { return positions_; }
+
+  // Distances from each landmark to p, or unreachable.
+  unsigned const*
+  distances(position p) const {
+    return &distances_[(p.y * map_->width() + p.x) * positions_.size()];
+  }
+
+  // Number of bytes taken by the distance tables.
+  std::size_t
+  memory() const { return distances_.capacity() * sizeof(unsigned); }
+
+private:
+  std::shared_ptr<::map const> map_;
+  std::vector<position> positions_;
+  std::vector<unsigned> distances_;  // Per tile, then per landmark.
+};
+
+// Heuristic for a_star taking the best of the Manhattan distance and the
+// landmark bounds. Without landmarks, this is just the Manhattan distance.
+class alt_heuristic {
+public:
+  explicit
+  alt_heuristic(position destination)
+    : destination_(destination)
+  { }
+
+  alt_heuristic(landmarks const* lm, position destination)
+    : destination_(destination)
+    , landmarks_(lm && lm->count() > 0 ? lm : nullptr)
+    , to_destination_(landmarks_ ? landmarks_->distances(destination)
+                                 : nullptr)
+  { }
+
+  double
+  operator () (position from, world const&) const { return (*this)(from); }
+
+  unsigned
+  operator () (position from) const {
+    unsigned result = distance(from, destination_);
+    if (!landmarks_)
+      return result;
+
+    unsigned const* const to_from = landmarks_->distances(from);
+    for (unsigned i = 0; i < landmarks_->count(); ++i)
+      if (to_from[i] != landmarks::unreachable
+          && to_destination_[i] != landmarks::unreachable) {
+        unsigned const bound = to_from[i] > to_destination_[i]
+          ? to_from[i] - to_destination_[i]
+          : to_destination_[i] - to_from[i];
+        result = std::max(result, bound);
+      }
+
+    return result;
+  }
+
+private:
+  position destination_;
+  landmarks const* landmarks_ = nullptr;
+  unsigned const* to_destination_ = nullptr;
+};
+
+// The landmarks if they're for the world's map, null otherwise.
+inline landmarks const*
+landmarks_for(std::shared_ptr<landmarks const> const& lm, world const& w) {
+  return lm && lm->map() == w.map() ? lm.get() : nullptr;
+}
+
+#endif
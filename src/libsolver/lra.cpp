@@ -3,19 +3,40 @@
 #include "a_star.hpp"
 #include "predictor.hpp"
 
+#include <stdexcept>
+
 lra::lra(log_sink& log,
          unsigned rejoin_limit,
          std::unique_ptr<predictor> predictor,
          unsigned obstacle_penalty,
-         double obstacle_threshold)
+         double obstacle_threshold,
+         std::shared_ptr<landmarks const> landmarks,
+         bool incremental,
+         std::shared_ptr<cluster_hierarchy const> hierarchy)
 : separate_paths_solver(log, rejoin_limit, std::move(predictor),
-                        obstacle_penalty, obstacle_threshold)
-{ }
+                        obstacle_penalty, obstacle_threshold,
+                        std::move(landmarks))
+, incremental_(incremental)
+, hierarchy_(std::move(hierarchy))
+{
+  if (incremental_ && predictor_)
+    throw std::runtime_error{
+      "Incremental replanning can't be used with an obstacle predictor"
+    };
+}
 
 std::vector<std::string>
 lra::stat_names() const {
   std::vector<std::string> result = separate_paths_solver::stat_names();
   result.push_back("Nodes expanded");
+  if (incremental_) {
+    result.push_back("Incremental searches");
+    result.push_back("Searches from scratch");
+  }
+  if (hierarchy_) {
+    result.push_back("Hierarchical searches");
+    result.push_back("Hierarchical search failures");
+  }
   return result;
 }
 
@@ -23,6 +44,14 @@ std::vector<std::string>
 lra::stat_values() const {
   std::vector<std::string> result = separate_paths_solver::stat_values();
   result.push_back(std::to_string(nodes_));
+  if (incremental_) {
+    result.push_back(std::to_string(incremental_searches_));
+    result.push_back(std::to_string(scratch_searches_));
+  }
+  if (hierarchy_) {
+    result.push_back(std::to_string(hierarchical_searches_));
+    result.push_back(std::to_string(hierarchical_failures_));
+  }
   return result;
 }
 
@@ -35,22 +64,22 @@ lra::get_obstacle_field() const {
 }
 
 auto
-lra::make_rejoin_search(position from, position to, world const& w,
-                        agent const&)
-  -> std::unique_ptr<rejoin_search_type> {
-  return std::make_unique<rejoin_search_type>(
+lra::rejoin_search(position from, position to, world const& w, agent const&)
+  -> rejoin_search_type& {
+  rejoin_search_.reset(
     from, to, w, should_stop_,
-    manhattan_distance_heuristic{to},
+    alt_heuristic{landmarks_for(landmarks_, w), to},
     predicted_cost(predictor_.get(), w.tick(), obstacle_penalty_),
     passable_if_not_predicted_obstacle(from, predictor_.get(),
                                        obstacle_threshold_)
   );
+  return rejoin_search_;
 }
 
 double
-lra::agitated_distance::operator () (position from, world const&) const {
+lra::agitated_distance::operator () (position from, world const& w) const {
   std::uniform_real_distribution<> agit(0.0, agitation);
-  return distance(from, destination) + agit(rng);
+  return distance(from, w) + agit(rng);
 }
 
 bool
@@ -84,22 +113,95 @@ lra::find_path(position from, world const& w, std::default_random_engine& rng) {
       data_[a.id()].agitation = 0.0;
   }
 
-  a_star<
-    position, position_successors,
-    passable_if_not_predicted_obstacle, agitated_distance,
-    predicted_cost
-  > as(
-    from, a.target, w, should_stop_,
-    agitated_distance{a.target, data_[a.id()].agitation, rng},
-    predicted_cost(predictor_.get(), w.tick(), obstacle_penalty_),
-    passable_if_not_predicted_obstacle{
-      from, predictor_.get(), obstacle_threshold_
+  agitated_distance const distance{
+    alt_heuristic{landmarks_for(landmarks_, w), a.target},
+    data_[a.id()].agitation, rng
+  };
+
+  path<> new_path;
+  if (incremental_ && data_[a.id()].agitation == 0.0)
+    new_path = find_path_incremental(from, a, w);
+  else if (!predictor_) {
+    if (incremental_)
+      ++scratch_searches_;
+
+    if (cluster_hierarchy const* hierarchy = hierarchy_for(hierarchy_, w)) {
+      ++hierarchical_searches_;
+      new_path = hierarchical_search_.find_path(
+        *hierarchy, from, a.target, w, should_stop_,
+        passable_not_immediate_neighbour{from}, distance
+      );
+      nodes_ += hierarchical_search_.nodes_expanded();
+
+      if (new_path.empty())
+        ++hierarchical_failures_;
     }
-  );
-  path<> new_path = as.find_path(w);
-  nodes_ += as.nodes_expanded();
+
+    if (new_path.empty() && !should_stop_) {
+      jps_search_.reset(
+        from, a.target, w, should_stop_, distance, manhattan_step_cost{},
+        always_passable{},
+        jps_successors<passable_not_immediate_neighbour>{
+          a.target, passable_not_immediate_neighbour{from}
+        }
+      );
+      new_path = expand_jumps(jps_search_.find_path(w));
+      nodes_ += jps_search_.nodes_expanded();
+    }
+  } else {
+    search_.reset(
+      from, a.target, w, should_stop_, distance,
+      predicted_cost(predictor_.get(), w.tick(), obstacle_penalty_),
+      passable_if_not_predicted_obstacle{
+        from, predictor_.get(), obstacle_threshold_
+      }
+    );
+    new_path = search_.find_path(w);
+    nodes_ += search_.nodes_expanded();
+  }
 
   data_[a.id()].last_recalculation = w.tick();
 
   return new_path;
 }
+
+path<>
+lra::rejoin_beyond_limit(position from, position to, world const& w) {
+  cluster_hierarchy const* hierarchy = hierarchy_for(hierarchy_, w);
+  if (predictor_ || !hierarchy)
+    return {};
+
+  ++hierarchical_searches_;
+  path<> result = hierarchical_search_.find_path(
+    *hierarchy, from, to, w, should_stop_,
+    passable_not_immediate_neighbour{from},
+    alt_heuristic{landmarks_for(landmarks_, w), to}
+  );
+  nodes_rejoin_ += hierarchical_search_.nodes_expanded();
+
+  if (result.empty())
+    ++hierarchical_failures_;
+
+  return result;
+}
+
+// The agitated search finds randomised detours rather than shortest paths, so
+// this is only used when the agent is calm. The agent's D* Lite is kept across
+// replans and only told which tiles next to the agent are blocked now.
+path<>
+lra::find_path_incremental(position from, agent const& a, world const& w) {
+  std::unique_ptr<d_star_lite>& search = data_[a.id()].incremental_search;
+  if (!search || search->goal() != a.target || search->map() != w.map())
+    search = std::make_unique<d_star_lite>(w.map(), a.target,
+                                           landmarks_for(landmarks_, w));
+
+  std::vector<position> blocked;
+  for (position n : w.map()->adjacent(from))
+    if (w.get(n) != tile::free)
+      blocked.push_back(n);
+
+  path<> result = search->find_path(from, std::move(blocked), should_stop_);
+  nodes_ += search->nodes_expanded();
+  ++incremental_searches_;
+  return result;
+}
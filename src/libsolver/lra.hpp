@@ -2,10 +2,12 @@
 #define LRA_HPP
 
 #include "a_star.hpp"
+#include "d_star_lite.hpp"
+#include "hpa.hpp"
+#include "jps.hpp"
+#include "predictor.hpp"
 #include "separate_paths_solver.hpp"
 
-class predicted_cost;
-
 class lra : public separate_paths_solver<lra> {
   struct passable_if_not_predicted_obstacle;
 
@@ -14,16 +16,23 @@ public:
     position,
     position_successors,
     passable_if_not_predicted_obstacle,
-    manhattan_distance_heuristic,
+    alt_heuristic,
     predicted_cost,
-    space_time_coordinate
+    space_time_coordinate,
+    position_distance_storage,
+    always_close<position_time>,
+    coord_open_set,
+    radix_queue
   >;
 
   lra(log_sink& log,
       unsigned rejoin_limit,
       std::unique_ptr<predictor> predictor,
       unsigned obstacle_penalty,
-      double obstacle_threshold);
+      double obstacle_threshold,
+      std::shared_ptr<landmarks const> landmarks = {},
+      bool incremental = false,
+      std::shared_ptr<cluster_hierarchy const> hierarchy = {});
 
   std::string name() const override { return "LRA*"; }
 
@@ -36,21 +45,28 @@ public:
   std::unordered_map<position_time, double>
   get_obstacle_field() const override;
 
-  std::unique_ptr<rejoin_search_type>
-  make_rejoin_search(position from, position to, world const& w,
-                     agent const& agent);
+  // Reset the rejoin search for the given agent and return it.
+  rejoin_search_type&
+  rejoin_search(position from, position to, world const& w,
+                agent const& agent);
 
 private:
   struct agent_data {
     boost::optional<tick_t> last_recalculation;
     double agitation = 0;
+    std::unique_ptr<d_star_lite> incremental_search;
   };
 
   struct passable_not_immediate_neighbour {
     position from;
-    bool operator () (position p, position, world const& w, unsigned) const {
+
+    bool operator () (position p, world const& w) const {
       return w.get(p) == tile::free || !neighbours(p, from);
     }
+
+    bool operator () (position p, position, world const& w, unsigned) const {
+      return operator () (p, w);
+    }
   };
 
   struct passable_if_not_predicted_obstacle {
@@ -72,18 +88,60 @@ private:
   };
 
   struct agitated_distance {
-    position destination;
+    alt_heuristic distance;
     double agitation;
     std::default_random_engine& rng;
 
     double operator () (position from, world const&) const;
   };
 
+  using search_type = a_star<
+    position, position_successors,
+    passable_if_not_predicted_obstacle, agitated_distance,
+    predicted_cost, space_coordinate<>, no_distance_storage,
+    always_close<position>, grid_open_set, radix_queue, grid_closed_set
+  >;
+
+  // Search used without a predictor. Then steps have uniform cost and the only
+  // obstacles considered are those next to the agent, so jump point search
+  // applies.
+  using jps_search_type = a_star<
+    position, jps_successors<passable_not_immediate_neighbour>,
+    always_passable, agitated_distance, manhattan_step_cost,
+    space_coordinate<>, no_distance_storage,
+    always_close<position>, grid_open_set, radix_queue, grid_closed_set
+  >;
+
   std::unordered_map<agent::id_type, agent_data> data_;
   unsigned nodes_ = 0;
+  unsigned incremental_searches_ = 0;
+  unsigned scratch_searches_ = 0;  // While agitated, in incremental mode.
+  unsigned hierarchical_searches_ = 0;
+  unsigned hierarchical_failures_ = 0;
+
+  // Replan incrementally with D* Lite instead of searching from scratch while
+  // the agent isn't agitated. D* Lite's edge costs don't change with time, so
+  // predicted costs, which do, can't be repaired by it; the constructor
+  // refuses a predictor in this mode.
+  bool incremental_;
+
+  // Without a predictor, search the hierarchy first and the full map only if
+  // that fails. It's also used to rejoin the old path when that is further
+  // away than the rejoin search may go.
+  std::shared_ptr<cluster_hierarchy const> hierarchy_;
+  hierarchical_search<passable_not_immediate_neighbour> hierarchical_search_;
+  search_type search_;
+  jps_search_type jps_search_;
+  rejoin_search_type rejoin_search_;
 
   path<> find_path(position, world const&,
                    std::default_random_engine&) override;
+
+  path<>
+  find_path_incremental(position, agent const&, world const&);
+
+  path<>
+  rejoin_beyond_limit(position from, position to, world const&) override;
 };
 
 #endif
@@ -14,9 +14,18 @@ operator == (agents_state const& lhs, agents_state const& rhs) {
   return lhs.next_agent == rhs.next_agent && lhs.agents == rhs.agents;
 }
 
-struct state_successors {
-  static std::vector<agents_state>
-  get(agents_state const& state, world const& w);
+// Successors of an agents_state are the states in which the next agent has
+// been assigned an action. They are built one at a time in a scratch state that
+// is kept between calls, so that no memory is allocated once it's grown large
+// enough.
+class state_successors {
+public:
+  template <typename F>
+  void
+  visit(agents_state const& state, agents_state const*, world const& w, F f);
+
+private:
+  agents_state scratch_;
 };
 
 static direction
@@ -40,16 +49,17 @@ make_full(agents_state& state) {
     a.action = agent_action::unassigned;
 }
 
-std::vector<agents_state>
-state_successors::get(agents_state const& state, world const& w) {
-  std::vector<agents_state> result;
+template <typename F>
+void
+state_successors::visit(agents_state const& state, agents_state const*,
+                        world const& w, F f) {
+  scratch_ = state;
+  scratch_.next_agent = (state.next_agent + 1) % state.agents.size();
+  agent_state_record& slot = scratch_.agents[state.next_agent];
 
   auto add = [&] (agent_action action, position dest) {
-    result.push_back(state);
-    result.back().agents[state.next_agent].action = action;
-    result.back().agents[state.next_agent].position = dest;
-    result.back().next_agent =
-    (result.back().next_agent + 1) % result.back().agents.size();
+    slot.action = action;
+    slot.position = dest;
 
 #ifndef NDEBUG
     for (agent_state_record const& agent_a : state.agents)
@@ -60,18 +70,27 @@ state_successors::get(agents_state const& state, world const& w) {
                agent_a.position != agent_b.position);
 #endif
 
-    if (result.back().next_agent == 0)
-      make_full(result.back());
+    if (scratch_.next_agent == 0) {
+      make_full(scratch_);
+      f(static_cast<agents_state const&>(scratch_));
+
+      // Undo make_full for the next successor.
+      for (std::size_t i = 0; i < state.agents.size(); ++i)
+        scratch_.agents[i].action = state.agents[i].action;
+    } else
+      f(static_cast<agents_state const&>(scratch_));
   };
 
   agent_state_record const& agent = state.agents[state.next_agent];
   assert(agent.action == agent_action::unassigned);
 
+  unsigned const passable = w.map()->passable_neighbours(agent.position);
   for (direction d : all_directions) {
-    position const destination = translate(agent.position, d);
-    if (!in_bounds(destination, *w.map()) || w.get(destination) == tile::wall)
+    if (!(passable & (1u << (unsigned) d)))
       continue;
 
+    position const destination = translate(agent.position, d);
+
     bool possible = true;
 
     for (agent_state_record const& other_agent : state.agents) {
@@ -116,15 +135,17 @@ state_successors::get(agents_state const& state, world const& w) {
 
   if (!needs_vacate)
     add(agent_action::stay, agent.position);
-
-  return result;
 }
 
 operator_decomposition::
 combined_heuristic_distance::combined_heuristic_distance(
-  heuristic_map_type& h_searches
+  heuristic_map_type& h_searches,
+  distance_table_map_type& tables,
+  unsigned& table_nodes
 )
   : h_searches_(h_searches)
+  , tables_(tables)
+  , table_nodes_(table_nodes)
 {}
 
 unsigned
@@ -133,6 +154,17 @@ operator_decomposition::combined_heuristic_distance::operator () (
 ) const {
   unsigned result = 0;
   for (agent_state_record const& agent : state.agents) {
+    if (!tables_.empty()) {
+      auto table = tables_.find(agent.id);
+      assert(table != tables_.end());
+
+      boost::optional<unsigned> d =
+        table->second->distance(agent.position, table_nodes_);
+      double const distance = d ? *d : infinity;
+      result += distance;
+      continue;
+    }
+
     auto h_search = h_searches_.find(agent.id);
     assert(h_search != h_searches_.end());
 
@@ -287,6 +319,8 @@ operator_decomposition::step(world& w, std::default_random_engine&) {
   if (predictor_)
     predictor_->update_obstacles(w);
 
+  retire_reservations(w.tick());
+
   admissibility ad = plans_admissible(w);
   if (groups_.empty() || ad != admissibility::admissible) {
     if (ad == admissibility::invalid)
@@ -308,7 +342,7 @@ operator_decomposition::step(world& w, std::default_random_engine&) {
     result.extend(make_action(current, group.plan.back()));
   }
 
-  w = apply(result, std::move(w));
+  w.apply(result);
 }
 
 std::vector<position>
@@ -493,6 +527,38 @@ struct hash<agents_state_time> {
 };
 } // namespace std
 
+struct operator_decomposition::primary_search {
+  a_star<
+    agents_state,
+    state_successors,
+    passable_not_immediate_neighbour,
+    combined_heuristic_distance,
+    unitary_step_cost,
+    agents_state_coordinate,
+    no_distance_storage,
+    close_full,
+    coord_open_set,
+    bucket_queue
+  > search;
+};
+
+operator_decomposition::operator_decomposition(
+  unsigned window,
+  std::unique_ptr<predictor> predictor,
+  unsigned obstacle_penalty,
+  double obstacle_threshold,
+  std::shared_ptr<landmarks const> landmarks
+)
+  : primary_search_(std::make_unique<primary_search>())
+  , window_(window)
+  , predictor_(std::move(predictor))
+  , obstacle_penalty_(obstacle_penalty)
+  , obstacle_threshold_(obstacle_threshold)
+  , landmarks_(std::move(landmarks))
+{ }
+
+operator_decomposition::~operator_decomposition() = default;
+
 path<agents_state>
 operator_decomposition::replan_group(world const& w,
                                      group const& group) {
@@ -510,22 +576,14 @@ operator_decomposition::replan_group(world const& w,
     goal_state.agents.push_back({a.target, a.id()});
   }
 
-  using search_type = a_star<
-    agents_state,
-    state_successors,
-    passable_not_immediate_neighbour,
-    combined_heuristic_distance,
-    unitary_step_cost,
-    agents_state_coordinate,
-    no_distance_storage,
-    close_full
-  >;
-  search_type search(
+  auto& search = primary_search_->search;
+  search.reset(
     current_state,
     goal_state,
     w,
     should_stop_,
-    combined_heuristic_distance(heuristic_searches_),
+    combined_heuristic_distance(heuristic_searches_, distance_tables_,
+                                nodes_heuristic_),
     unitary_step_cost{},
     passable_not_immediate_neighbour{current_state, predictor_.get()}
   );
@@ -597,11 +655,9 @@ operator_decomposition::plans_admissible(world const& w) const -> admissibility
 
 bool
 operator_decomposition::final(agents_state const& state, world const& w) const {
-  for (agent_state_record const& agent : state.agents) {
-    assert(w.get_agent(agent.position));
-    if (w.get_agent(agent.position)->target != agent.position)
+  for (agent_state_record const& agent : state.agents)
+    if (w.get_agent(agent.id).target != agent.position)
       return false;
-  }
 
   return true;
 }
@@ -668,6 +724,34 @@ operator_decomposition::unreserve(group_id group) {
   do_it(permanent_reservation_table_);
 }
 
+void
+operator_decomposition::retire_reservations(tick_t now) {
+  // Sweeping the table once per window keeps the cost per reservation
+  // constant.
+  if (now < next_retirement_)
+    return;
+  next_retirement_ = now + std::max(window_, 1u);
+
+  for (auto it = reservation_table_.begin(); it != reservation_table_.end(); )
+    if (it->first.time < now) {
+      it = reservation_table_.erase(it);
+      ++reservations_retired_;
+    } else
+      ++it;
+}
+
+std::size_t
+operator_decomposition::reservation_memory() const {
+  // Each hash node holds the value and a link to the next node.
+  return reservation_table_.bucket_count() * sizeof(void*)
+    + reservation_table_.size()
+      * (sizeof(reservation_table_type::value_type) + sizeof(void*))
+    + permanent_reservation_table_.bucket_count() * sizeof(void*)
+    + permanent_reservation_table_.size()
+      * (sizeof(permanent_reservation_table_type::value_type)
+         + sizeof(void*));
+}
+
 auto
 operator_decomposition::find_conflict(position to,
                                       boost::optional<position> from,
@@ -716,20 +800,41 @@ operator_decomposition::find_permanent_conflict(position pos,
 
 void
 operator_decomposition::make_heuristic_searches(world const& w) {
-  heuristic_searches_.clear();
+  // Without a predictor, distances to goals don't depend on time and are
+  // shared through the cache.
+  if (!predictor_) {
+    if (!distances_ || distances_->map() != w.map())
+      distances_ = distance_cache::for_map(w.map());
+
+    heuristic_searches_.clear();
+    distance_tables_.clear();
+    for (auto const& pos_agent : w.agents()) {
+      agent const& a = std::get<1>(pos_agent);
+      distance_tables_.emplace(a.id(), distances_->get(a.target));
+    }
+
+    return;
+  }
+
+  distance_tables_.clear();
+
+  // Searches of agents that are still around are reset rather than
+  // recreated, so that they keep their memory.
+  for (auto it = heuristic_searches_.begin(); it != heuristic_searches_.end(); )
+    if (w.agent_position(it->first))
+      ++it;
+    else
+      it = heuristic_searches_.erase(it);
 
   for (auto const& pos_agent : w.agents()) {
     position from = std::get<0>(pos_agent);
     agent const& a = std::get<1>(pos_agent);
 
-    heuristic_searches_.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(a.id()),
-      std::forward_as_tuple(a.target, from, w,
-                            should_stop_,
-                            manhattan_distance_heuristic{from},
-                            predicted_cost{predictor_.get(), w.tick(),
-                                           obstacle_penalty_})
+    heuristic_searches_[a.id()].reset(
+      a.target, from, w,
+      should_stop_,
+      alt_heuristic{landmarks_for(landmarks_, w), from},
+      predicted_cost{predictor_.get(), w.tick(), obstacle_penalty_}
     );
   }
 }
@@ -2,6 +2,8 @@
 #define OPERATOR_DECOMPOSITION_HPP
 
 #include "a_star.hpp"
+#include "distance_cache.hpp"
+#include "landmarks.hpp"
 #include "predictor.hpp"
 #include "solvers.hpp"
 
@@ -30,12 +32,9 @@ public:
   operator_decomposition(unsigned window,
                          std::unique_ptr<predictor> predictor,
                          unsigned obstacle_penalty,
-                         double obstacle_threshold)
-    : window_(window)
-    , predictor_(std::move(predictor))
-    , obstacle_penalty_(obstacle_penalty)
-    , obstacle_threshold_(obstacle_threshold)
-  { }
+                         double obstacle_threshold,
+                         std::shared_ptr<landmarks const> landmarks = {});
+  ~operator_decomposition() override;
 
   void step(world&, std::default_random_engine&) override;
   std::string name() const override { return "OD"; }
@@ -43,7 +42,8 @@ public:
   std::vector<std::string>
   stat_names() const override {
     return {"Replans", "Plan invalid", "Nodes primary", "Nodes heuristic",
-            "Total nodes expanded", "Max group size"};
+            "Total nodes expanded", "Max group size", "Reservations retired",
+            "Reservation memory"};
   }
 
   std::vector<std::string>
@@ -54,7 +54,9 @@ public:
       std::to_string(nodes_primary_),
       std::to_string(nodes_heuristic_),
       std::to_string(nodes_primary_ + nodes_heuristic_),
-      std::to_string(max_group_size_)
+      std::to_string(max_group_size_),
+      std::to_string(reservations_retired_),
+      std::to_string(reservation_memory())
     };
   }
 
@@ -100,18 +102,29 @@ private:
 
   using heuristic_search_type = a_star<
     position, position_successors, always_passable,
-    manhattan_distance_heuristic, predicted_cost
+    alt_heuristic, predicted_cost, space_coordinate<>,
+    grid_distance_storage, always_close<position>, grid_open_set,
+    radix_queue, grid_closed_set
   >;
   using heuristic_map_type = std::map<agent::id_type, heuristic_search_type>;
+  using distance_table_map_type =
+    std::map<agent::id_type, std::shared_ptr<distance_table>>;
 
+  // Sum of true distances of agents to their goals. These come from the
+  // shared distance tables if there are any, or from the heuristic searches
+  // otherwise. Tiles expanded in the tables are added to table_nodes.
   struct combined_heuristic_distance {
-    combined_heuristic_distance(heuristic_map_type& h_searches);
+    combined_heuristic_distance(heuristic_map_type& h_searches,
+                                distance_table_map_type& tables,
+                                unsigned& table_nodes);
 
     unsigned
     operator () (agents_state const& state, world const& w) const;
 
   private:
     heuristic_map_type& h_searches_;
+    distance_table_map_type& tables_;
+    unsigned& table_nodes_;
   };
 
   struct passable_not_immediate_neighbour {
@@ -124,21 +137,31 @@ private:
                  unsigned);
   };
 
+  // The search over agents_state, reused across groups. Its policies are
+  // defined in the implementation file.
+  struct primary_search;
+
   heuristic_map_type heuristic_searches_;
+  distance_table_map_type distance_tables_;
+  std::shared_ptr<distance_cache> distances_;
+  std::unique_ptr<primary_search> primary_search_;
   group_list groups_;
   reservation_table_type reservation_table_;
   permanent_reservation_table_type permanent_reservation_table_;
   tick_t last_nonpermanent_reservation_ = 0;
+  tick_t next_retirement_ = 0;
   unsigned window_;
   std::unique_ptr<predictor> predictor_;
   unsigned obstacle_penalty_ = 100;
   double obstacle_threshold_ = 0.5;
+  std::shared_ptr<landmarks const> landmarks_;
 
   unsigned replans_ = 0;
   unsigned plan_invalid_ = 0;
   unsigned nodes_primary_ = 0;
   unsigned nodes_heuristic_ = 0;
   unsigned max_group_size_ = 0;
+  std::size_t reservations_retired_ = 0;
 
   void
   replan(world const& w);
@@ -170,6 +193,13 @@ private:
   void
   unreserve(group_id);
 
+  // Drop the reservations of ticks before now.
+  void
+  retire_reservations(tick_t now);
+
+  std::size_t
+  reservation_memory() const;
+
   boost::optional<group_id>
   find_conflict(position to, boost::optional<position> from, tick_t time,
                 bool permanent) const;
@@ -20,20 +20,18 @@ movement_estimator::movement_estimator(world const& w) {
 
 void
 movement_estimator::update(world const& w) {
-  for (auto const& pos_obstacle : w.obstacles()) {
-    obstacle::id_type id = std::get<1>(pos_obstacle).id();
-    auto last = last_obstacles_.find(id);
-
-    if (last == last_obstacles_.end())
+  for (auto const& id_pos : last_obstacles_) {
+    boost::optional<position> const current =
+      w.obstacle_position(std::get<0>(id_pos));
+    if (!current)
       continue;
 
-    position current = std::get<0>(pos_obstacle);
-
-    if (current == last->second)
+    position const last = std::get<1>(id_pos);
+    if (*current == last)
       ++move_count_[static_cast<std::size_t>(movement::stay)];
     else
       ++move_count_[static_cast<std::size_t>(
-        direction_to_movement(direction_to(last->second, current))
+        direction_to_movement(direction_to(last, *current))
       )];
 
     ++num_moves_;
@@ -70,10 +68,10 @@ movement_estimator::store_positions(world const& w) {
 
   last_obstacles_.clear();
 
+  last_obstacles_.reserve(w.obstacles().size());
   for (auto const& pos_obstacle : w.obstacles())
-    last_obstacles_.insert(
-      {std::get<1>(pos_obstacle).id(), std::get<0>(pos_obstacle)}
-    );
+    last_obstacles_.emplace_back(std::get<1>(pos_obstacle).id(),
+                                 std::get<0>(pos_obstacle));
 
 #ifndef NDEBUG
   last_tick_ = w.tick();
@@ -91,87 +89,39 @@ estimates_diff(movement_estimator::estimates_type const& x,
   return result;
 }
 
-namespace {
-
-class recursive_predictor : public predictor {
-public:
-  recursive_predictor(world const& w, unsigned cutoff)
-    : world_(&w)
-    , cutoff_(cutoff)
-    , estimator_(w)
-  {}
-
-  void update_obstacles(world const&) override;
-  double predict_obstacle(position_time) override;
-
-  std::unordered_map<position_time, double> field() const override {
-    return obstacles_;
-  }
-
-private:
-  std::unordered_map<position_time, double> obstacles_;
-  tick_t last_update_time_ = 0;
-  world const* world_ = nullptr;
-  unsigned cutoff_ = 0;
-  movement_estimator estimator_;
-};
-
-}
-
-std::unique_ptr<predictor>
-make_recursive_predictor(world const& w, unsigned cutoff) {
-  return std::make_unique<recursive_predictor>(w, cutoff);
-}
-
-void
-recursive_predictor::update_obstacles(world const& w) {
-  assert(world_->map() == w.map());
-
-  if (w.tick() == last_update_time_)
-    return;
-
-  obstacles_.clear();
-
-  for (auto pos_obstacle : w.obstacles())
-    obstacles_[{std::get<0>(pos_obstacle), w.tick()}] = 1.0;
-
-  last_update_time_ = w.tick();
-
-  estimator_.update(w);
-}
-
-double
-recursive_predictor::predict_obstacle(position_time where) {
-  assert(where.time >= last_update_time_);
-
-  if (cutoff_ && where.time - last_update_time_ > cutoff_)
-    where.time = last_update_time_ + cutoff_;
+using obstacle_field = std::unordered_map<position_time, double>;
 
+// Probability of an obstacle at where, given the obstacles known at the time of
+// the last update. Probabilities worked out on the way are kept in field.
+static double
+predict_recursively(position_time where, obstacle_field& field,
+                    world const& w, movement_estimator const& estimator,
+                    tick_t last_update_time) {
   std::stack<position_time> stack;
   stack.push(where);
 
   while (!stack.empty()) {
     position_time pt = stack.top();
 
-    if (obstacles_.count(pt)) {
+    if (field.count(pt)) {
       stack.pop();
       continue;
     }
 
-    if (pt.time == last_update_time_
-        || world_->get({pt.x, pt.y}) == tile::wall
-        || world_->get({pt.x, pt.y}) == tile::agent) {
-      obstacles_[pt] = 0.0;
+    if (pt.time == last_update_time
+        || w.get({pt.x, pt.y}) == tile::wall
+        || w.get({pt.x, pt.y}) == tile::agent) {
+      field[pt] = 0.0;
       stack.pop();
 
     } else {
       bool have_neighbours = true;
       double complementary_prob = 1.0;
 
-      double stay_probability = estimator_.estimate(movement::stay);
+      double stay_probability = estimator.estimate(movement::stay);
 
-      auto previous = obstacles_.find({pt.x, pt.y, pt.time - 1});
-      if (previous == obstacles_.end()) {
+      auto previous = field.find({pt.x, pt.y, pt.time - 1});
+      if (previous == field.end()) {
         stack.push({pt.x, pt.y, pt.time - 1});
         have_neighbours = false;
       } else
@@ -181,11 +131,11 @@ recursive_predictor::predict_obstacle(position_time where) {
         position p = translate({pt.x, pt.y}, d);
         position_time neighbour_pt{p, pt.time - 1};
 
-        if (world_->get(p) == tile::wall || world_->get(p) == tile::agent)
+        if (w.get(p) == tile::wall || w.get(p) == tile::agent)
           continue;
 
-        auto neighbour = obstacles_.find(neighbour_pt);
-        if (neighbour == obstacles_.end()) {
+        auto neighbour = field.find(neighbour_pt);
+        if (neighbour == field.end()) {
           stack.push({translate({pt.x, pt.y}, d), pt.time - 1});
           have_neighbours = false;
         }
@@ -195,7 +145,7 @@ recursive_predictor::predict_obstacle(position_time where) {
 
         double probability =
           neighbour->second *
-          estimator_.estimate(direction_to_movement(
+          estimator.estimate(direction_to_movement(
             direction_to(p, {pt.x, pt.y})
           ));
 
@@ -206,17 +156,130 @@ recursive_predictor::predict_obstacle(position_time where) {
         assert(complementary_prob >= 0.0);
         assert(complementary_prob <= 1.0);
 
-        obstacles_[pt] = 1 - complementary_prob;
+        field[pt] = 1 - complementary_prob;
         stack.pop();
       }
     }
   }
 
-  assert(obstacles_.count(where));
-  assert(obstacles_[where] >= 0.0);
-  assert(obstacles_[where] <= 1.0);
+  assert(field.count(where));
+  assert(field[where] >= 0.0);
+  assert(field[where] <= 1.0);
 
-  return obstacles_[where];
+  return field[where];
+}
+
+namespace {
+
+class recursive_predictor : public predictor {
+public:
+  recursive_predictor(world const& w, unsigned cutoff)
+    : world_(&w)
+    , cutoff_(cutoff)
+    , estimator_(w)
+  {}
+
+  void update_obstacles(world const&) override;
+  double predict_obstacle(position_time) override;
+
+  std::unordered_map<position_time, double> field() const override {
+    return obstacles_;
+  }
+
+  // Tiles with agents on them are taken to be free of obstacles when first
+  // asked about.
+  bool depends_on_agents() const override { return true; }
+
+  std::unique_ptr<predictor> make_reader() const override;
+
+private:
+  friend class recursive_reader;
+
+  obstacle_field obstacles_;
+  tick_t last_update_time_ = 0;
+  world const* world_ = nullptr;
+  unsigned cutoff_ = 0;
+  movement_estimator estimator_;
+
+  position_time
+  limit(position_time where) const {
+    assert(where.time >= last_update_time_);
+
+    if (cutoff_ && where.time - last_update_time_ > cutoff_)
+      where.time = last_update_time_ + cutoff_;
+    return where;
+  }
+};
+
+// Starts each update from a copy of the source's probabilities and then works
+// out the rest in its own copy.
+class recursive_reader : public predictor {
+public:
+  explicit
+  recursive_reader(recursive_predictor const& source) : source_(source) { }
+
+  void update_obstacles(world const&) override { }
+
+  double
+  predict_obstacle(position_time where) override {
+    if (!synced_ || *synced_ != source_.last_update_time_) {
+      obstacles_ = source_.obstacles_;
+      synced_ = source_.last_update_time_;
+    }
+
+    return predict_recursively(source_.limit(where), obstacles_,
+                               *source_.world_, source_.estimator_,
+                               source_.last_update_time_);
+  }
+
+  std::unordered_map<position_time, double> field() const override {
+    return source_.field();
+  }
+
+  bool depends_on_agents() const override { return true; }
+
+  std::unique_ptr<predictor>
+  make_reader() const override { return source_.make_reader(); }
+
+private:
+  recursive_predictor const& source_;
+  obstacle_field obstacles_;
+  boost::optional<tick_t> synced_;
+};
+
+}
+
+std::unique_ptr<predictor>
+make_recursive_predictor(world const& w, unsigned cutoff) {
+  return std::make_unique<recursive_predictor>(w, cutoff);
+}
+
+void
+recursive_predictor::update_obstacles(world const& w) {
+  assert(world_->map() == w.map());
+
+  if (w.tick() == last_update_time_)
+    return;
+
+  obstacles_.clear();
+
+  for (auto pos_obstacle : w.obstacles())
+    obstacles_[{std::get<0>(pos_obstacle), w.tick()}] = 1.0;
+
+  last_update_time_ = w.tick();
+
+  estimator_.update(w);
+}
+
+double
+recursive_predictor::predict_obstacle(position_time where) {
+  return predict_recursively(limit(where), obstacles_, *world_, estimator_,
+                             last_update_time_);
+}
+
+std::unique_ptr<predictor>
+recursive_predictor::make_reader() const {
+  return std::make_unique<recursive_reader>(*this);
 }
 
 namespace {
@@ -231,8 +294,11 @@ public:
   void update_obstacles(world const&) override;
   double predict_obstacle(position_time) override;
   std::unordered_map<position_time, double> field() const override;
+  std::unique_ptr<predictor> make_reader() const override;
 
 private:
+  friend class matrix_reader;
+
   movement_estimator estimator_;
   movement_estimator::estimates_type last_estimate_;
 
@@ -244,6 +310,63 @@ private:
 
   position::coord_type
   linear(position p) const { return p.y * width_ + p.x; }
+
+  // Number of steps after the last update that pt is predicted as.
+  tick_t
+  steps(position_time pt) const {
+    assert(pt.time >= last_update_time_);
+
+    if (cutoff_ && pt.time - last_update_time_ > cutoff_)
+      return cutoff_;
+    return pt.time - last_update_time_;
+  }
+};
+
+// Uses the states the source has worked out, and works out any further ones
+// itself. Making them all in the source at each update would be simpler, but
+// most updates don't need all of them.
+class matrix_reader : public predictor {
+public:
+  explicit
+  matrix_reader(matrix_predictor const& source) : source_(source) { }
+
+  void update_obstacles(world const&) override { }
+
+  double
+  predict_obstacle(position_time pt) override {
+    tick_t const t = source_.steps(pt);
+    std::vector<obstacle_state_vector_type> const& states = source_.states_;
+    if (t < states.size())
+      return states[t](source_.linear({pt.x, pt.y}));
+
+    if (!synced_ || *synced_ != source_.last_update_time_
+        || further_from_ != states.size()) {
+      further_states_.clear();
+      synced_ = source_.last_update_time_;
+      further_from_ = states.size();
+    }
+
+    while (t - states.size() >= further_states_.size())
+      further_states_.push_back(
+        source_.transition_
+        * (further_states_.empty() ? states.back() : further_states_.back())
+      );
+
+    return further_states_[t - states.size()](source_.linear({pt.x, pt.y}));
+  }
+
+  std::unordered_map<position_time, double> field() const override {
+    return source_.field();
+  }
+
+  std::unique_ptr<predictor>
+  make_reader() const override { return source_.make_reader(); }
+
+private:
+  matrix_predictor const& source_;
+  std::vector<obstacle_state_vector_type> further_states_;
+  std::size_t further_from_ = 0;  // Steps the first further state is after.
+  boost::optional<tick_t> synced_;
 };
 
 }
@@ -261,50 +384,45 @@ make_transition_matrix(world const& w, movement_estimator const& estimator) {
   std::vector<position> neighbours;
   neighbours.reserve(4);
 
-  for (position::coord_type from_y = 0; from_y < m.height(); ++from_y)
-    for (position::coord_type from_x = 0; from_x < m.width(); ++from_x) {
-      position from{from_x, from_y};
-      if (w.get(from) == tile::wall || w.get(from) == tile::agent)
-        continue;
+  m.foreach_passable([&] (position from) {
+    if (w.get(from) == tile::agent)
+      return;
 
-      neighbours.clear();
-
-      for (direction d : all_directions) {
-        position to = translate(from, d);
-        if (!in_bounds(to, m) || w.get(to) == tile::wall)
-          continue;
-
-        neighbours.push_back(to);
-      }
+    neighbours.clear();
 
-      double const stay_probability = estimator.estimate(movement::stay);
-      double leftover = 1.0 - stay_probability;
+    unsigned const passable = m.passable_neighbours(from);
+    for (direction d : all_directions)
+      if (passable & (1u << (unsigned) d))
+        neighbours.push_back(translate(from, d));
 
-      if (neighbours.empty()) {
-        transitions.emplace_back(linear(from), linear(from), 1.0);
-        continue;
-      }
+    double const stay_probability = estimator.estimate(movement::stay);
+    double leftover = 1.0 - stay_probability;
 
-      for (position to : neighbours) {
-        double const transition_probability =
-          estimator.estimate(direction_to_movement(
-            direction_to(from, to)
-          ));
+    if (neighbours.empty()) {
+      transitions.emplace_back(linear(from), linear(from), 1.0);
+      return;
+    }
 
-        transitions.emplace_back(linear(to), linear(from),
-                                 transition_probability);
+    for (position to : neighbours) {
+      double const transition_probability =
+        estimator.estimate(direction_to_movement(
+          direction_to(from, to)
+        ));
 
-        leftover -= transition_probability;
-      }
+      transitions.emplace_back(linear(to), linear(from),
+                               transition_probability);
 
-      // It is possible that not all neighbours are traversable, and that we
-      // therefore have some leftover probability. We'll account this leftover
-      // to the stay probability as well, in order to make sure our transitions
-      // sum up to 1.0.
-      transitions.emplace_back(linear(from), linear(from),
-                               stay_probability + leftover);
+      leftover -= transition_probability;
     }
 
+    // It is possible that not all neighbours are traversable, and that we
+    // therefore have some leftover probability. We'll account this leftover
+    // to the stay probability as well, in order to make sure our transitions
+    // sum up to 1.0.
+    transitions.emplace_back(linear(from), linear(from),
+                             stay_probability + leftover);
+  });
+
   transition_matrix_type result(map_size, map_size);
   result.setFromTriplets(transitions.begin(), transitions.end());
 
@@ -359,13 +477,16 @@ matrix_predictor::update_obstacles(world const& w) {
 
 double
 matrix_predictor::predict_obstacle(position_time pt) {
-  if (cutoff_ && pt.time - last_update_time_ > cutoff_)
-    pt.time = last_update_time_ + cutoff_;
-
-  while (pt.time - last_update_time_ >= states_.size())
+  tick_t const t = steps(pt);
+  while (t >= states_.size())
     states_.push_back(transition_ * states_.back());
 
-  return states_[pt.time - last_update_time_](linear({pt.x, pt.y}));
+  return states_[t](linear({pt.x, pt.y}));
+}
+
+std::unique_ptr<predictor>
+matrix_predictor::make_reader() const {
+  return std::make_unique<matrix_reader>(*this);
 }
 
 std::unordered_map<position_time, double>
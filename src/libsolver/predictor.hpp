@@ -2,7 +2,9 @@
 #define PREDICTOR_HPP
 
 #include <memory>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "world.hpp"
 
@@ -33,7 +35,8 @@ public:
   estimates_type estimates() const { return estimate_; }
 
 private:
-  using obstacle_positions = std::unordered_map<obstacle::id_type, position>;
+  using obstacle_positions =
+    std::vector<std::tuple<obstacle::id_type, position>>;
 
   void clear();
   void store_positions(world const&);
@@ -51,9 +54,20 @@ private:
 // Predicts obstacle movement.
 class predictor {
 public:
+  virtual ~predictor() = default;
+
   virtual void update_obstacles(world const&) = 0;
   virtual double predict_obstacle(position_time) = 0;
   virtual std::unordered_map<position_time, double> field() const = 0;
+
+  // Whether predictions may change between updates as agents move.
+  virtual bool depends_on_agents() const { return false; }
+
+  // Make a predictor that gives the same predictions as this one, for use from
+  // another thread. Readers follow this predictor's updates and keep what they
+  // work out to themselves, so several can predict at once as long as this
+  // predictor is neither updated nor asked meanwhile.
+  virtual std::unique_ptr<predictor> make_reader() const = 0;
 };
 
 // Make a predictor that uses the recursive algorithm for prediction.
@@ -0,0 +1,332 @@
+#ifndef PRIORITY_QUEUE_HPP
+#define PRIORITY_QUEUE_HPP
+
+#include <boost/heap/fibonacci_heap.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Priority queue policies for a_star. Each is a template over the node type
+// and keeps pointers to nodes ordered by Node::f(), lowest first. A policy
+// provides:
+//
+//   handle_type push(Node*);
+//   static Node* get(handle_type);
+//   bool empty();
+//   Node* top();
+//   void pop();
+//   void decrease_key(handle_type);  // The node's f has decreased.
+//   void clear();                    // Remove all nodes, keep the memory.
+//
+// empty and top are not const because the lazy-deletion queues discard stale
+// entries in them.
+
+// Fibonacci heap with true decrease-key.
+template <typename Node>
+class fibonacci_queue {
+  struct compare {
+    bool
+    operator () (Node* x, Node* y) const { return x->f() > y->f(); }
+  };
+
+  using heap_type =
+    boost::heap::fibonacci_heap<Node*, boost::heap::compare<compare>>;
+
+public:
+  using handle_type = typename heap_type::handle_type;
+
+  handle_type push(Node* n)          { return heap_.push(n); }
+  static Node* get(handle_type h)    { return *h; }
+  bool empty() const                 { return heap_.empty(); }
+  Node* top() const                  { return heap_.top(); }
+  void pop()                         { heap_.pop(); }
+  void decrease_key(handle_type h)   { heap_.decrease(h); }
+  void clear()                       { heap_.clear(); }
+
+private:
+  heap_type heap_;
+};
+
+// Implicit d-ary heap in a flat array. decrease_key pushes the node again;
+// entries whose key no longer matches the node's f are stale and are skipped
+// when they reach the top.
+template <typename Node, unsigned Arity>
+class d_ary_queue {
+public:
+  using handle_type = Node*;
+
+  handle_type
+  push(Node* n) {
+    entries_.push_back({n->f(), n});
+    sift_up(entries_.size() - 1);
+    return n;
+  }
+
+  static Node* get(handle_type h)  { return h; }
+  bool empty()                     { prune(); return entries_.empty(); }
+  Node* top()                      { prune(); return entries_.front().node; }
+  void pop()                       { prune(); remove_top(); }
+  void decrease_key(handle_type n) { push(n); }
+  void clear()                     { entries_.clear(); }
+
+private:
+  struct entry {
+    double key;
+    Node* node;
+  };
+
+  std::vector<entry> entries_;
+
+  void
+  prune() {
+    while (!entries_.empty()
+           && entries_.front().key != entries_.front().node->f())
+      remove_top();
+  }
+
+  void
+  remove_top() {
+    entries_.front() = entries_.back();
+    entries_.pop_back();
+    if (!entries_.empty())
+      sift_down(0);
+  }
+
+  void
+  sift_up(std::size_t i) {
+    entry const e = entries_[i];
+    while (i > 0) {
+      std::size_t const parent = (i - 1) / Arity;
+      if (entries_[parent].key <= e.key)
+        break;
+
+      entries_[i] = entries_[parent];
+      i = parent;
+    }
+    entries_[i] = e;
+  }
+
+  void
+  sift_down(std::size_t i) {
+    entry const e = entries_[i];
+    while (true) {
+      std::size_t const first_child = i * Arity + 1;
+      if (first_child >= entries_.size())
+        break;
+
+      std::size_t const last_child =
+        std::min(first_child + Arity, entries_.size());
+      std::size_t best = first_child;
+      for (std::size_t c = first_child + 1; c < last_child; ++c)
+        if (entries_[c].key < entries_[best].key)
+          best = c;
+
+      if (e.key <= entries_[best].key)
+        break;
+
+      entries_[i] = entries_[best];
+      i = best;
+    }
+    entries_[i] = e;
+  }
+};
+
+template <typename Node>
+using binary_queue = d_ary_queue<Node, 2>;
+
+template <typename Node>
+using four_ary_queue = d_ary_queue<Node, 4>;
+
+// Bucket queue for searches whose f values are mostly small non-negative
+// integers, such as those with unitary_step_cost and an integer heuristic.
+// Nodes with equal f are taken last-in, first-out. Keys that don't fit a
+// bucket -- fractions, or huge values such as an infinite heuristic -- go to an
+// overflow heap, so any f is handled correctly, only less quickly. Uses lazy
+// deletion like d_ary_queue.
+template <typename Node>
+class bucket_queue {
+public:
+  using handle_type = Node*;
+
+  handle_type
+  push(Node* n) {
+    double const f = n->f();
+    if (!(f >= 0.0 && f < max_buckets && f == std::floor(f))) {
+      overflow_.push(n);
+      return n;
+    }
+
+    std::size_t const key = f;
+    if (key >= buckets_.size())
+      buckets_.resize(key + 1);
+
+    buckets_[key].push_back(n);
+    first_ = std::min(first_, key);
+    return n;
+  }
+
+  static Node* get(handle_type h) { return h; }
+
+  bool
+  empty() {
+    prune();
+    return first_ == buckets_.size() && overflow_.empty();
+  }
+
+  Node*
+  top() {
+    return from_bucket() ? buckets_[first_].back() : overflow_.top();
+  }
+
+  void
+  pop() {
+    if (from_bucket())
+      buckets_[first_].pop_back();
+    else
+      overflow_.pop();
+  }
+
+  void decrease_key(handle_type n) { push(n); }
+
+  void
+  clear() {
+    for (std::vector<Node*>& bucket : buckets_)
+      bucket.clear();
+    first_ = buckets_.size();
+    overflow_.clear();
+  }
+
+private:
+  static constexpr double max_buckets = 1 << 20;
+
+  std::vector<std::vector<Node*>> buckets_;
+  std::size_t first_ = 0;  // No non-empty bucket below this.
+  four_ary_queue<Node> overflow_;
+
+  void
+  prune() {
+    for (; first_ < buckets_.size(); ++first_) {
+      std::vector<Node*>& bucket = buckets_[first_];
+      while (!bucket.empty() && bucket.back()->f() != (double) first_)
+        bucket.pop_back();
+
+      if (!bucket.empty())
+        return;
+    }
+  }
+
+  // Whether the lowest node is in a bucket rather than in the overflow heap.
+  bool
+  from_bucket() {
+    prune();
+    return first_ < buckets_.size()
+      && (overflow_.empty() || (double) first_ <= overflow_.top()->f());
+  }
+};
+
+// Radix heap for searches with monotone f, that is, where no node pushed has
+// lower f than the node last popped. This holds for predicted_cost searches
+// with the Manhattan heuristic. Keys are the bit patterns of the f values,
+// which order the same as non-negative doubles. Keys below the last popped
+// one, e.g. due to rounding or an inconsistent heuristic, are clamped to it;
+// such a node is still the smallest one in the queue. Uses lazy deletion like
+// d_ary_queue.
+template <typename Node>
+class radix_queue {
+public:
+  using handle_type = Node*;
+
+  handle_type
+  push(Node* n) {
+    double const f = n->f();
+    std::uint64_t const key = std::max(to_key(f), last_);
+    buckets_[bucket(key)].push_back({key, f, n});
+    return n;
+  }
+
+  static Node* get(handle_type h)  { return h; }
+  bool empty()                     { prune(); return buckets_[0].empty(); }
+  Node* top()                      { prune(); return buckets_[0].back().node; }
+  void pop()                       { prune(); buckets_[0].pop_back(); }
+  void decrease_key(handle_type n) { push(n); }
+
+  void
+  clear() {
+    for (std::vector<entry>& bucket : buckets_)
+      bucket.clear();
+    last_ = 0;
+  }
+
+private:
+  struct entry {
+    std::uint64_t key;
+    double f;  // Node's f at the time of pushing.
+    Node* node;
+  };
+
+  // Bucket 0 holds keys equal to last_, bucket i keys whose highest bit
+  // differing from last_ is bit i - 1.
+  std::array<std::vector<entry>, 65> buckets_;
+  std::uint64_t last_ = 0;
+
+  static std::uint64_t
+  to_key(double f) {
+    if (!(f > 0.0))
+      return 0;
+
+    std::uint64_t result;
+    std::memcpy(&result, &f, sizeof(result));
+    return result;
+  }
+
+  std::size_t
+  bucket(std::uint64_t key) const {
+    return key == last_ ? 0 : 64 - __builtin_clzll(key ^ last_);
+  }
+
+  static bool
+  stale(entry const& e) { return e.f != e.node->f(); }
+
+  // Make bucket 0 hold the smallest live entries, if there are any.
+  void
+  prune() {
+    std::vector<entry>& front = buckets_[0];
+    while (true) {
+      while (!front.empty() && stale(front.back()))
+        front.pop_back();
+
+      if (!front.empty())
+        return;
+
+      std::size_t i = 1;
+      while (i < buckets_.size() && buckets_[i].empty())
+        ++i;
+
+      if (i == buckets_.size())
+        return;
+
+      std::vector<entry>& source = buckets_[i];
+      std::uint64_t min = std::numeric_limits<std::uint64_t>::max();
+      for (entry const& e : source)
+        if (!stale(e))
+          min = std::min(min, e.key);
+
+      if (min != std::numeric_limits<std::uint64_t>::max()) {
+        last_ = min;
+        for (entry const& e : source)
+          if (!stale(e))
+            buckets_[bucket(e.key)].push_back(e);
+      }
+
+      source.clear();
+    }
+  }
+};
+
+#endif
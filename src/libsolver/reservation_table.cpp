@@ -0,0 +1,136 @@
+#include "reservation_table.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+void
+reservation_table::prepare(std::shared_ptr<map const> const& m,
+                           tick_t horizon) {
+  horizon_ = horizon;
+  if (map_ == m)
+    return;
+
+  map_ = m;
+  layers_.clear();
+  agents_.clear();
+  next_retirement_ = 0;
+}
+
+void
+reservation_table::insert(position_time pt, record r) {
+  assert(pt.time >= now_);
+  assert(!count(pt));
+
+  grid_table<record>& tiles = writable_layer(pt.time).tiles;
+  if (record* existing = tiles.find(pt.position()))
+    *existing = r;
+  else
+    tiles.insert(pt.position(), r);
+
+  agents_[r.agent].push_back(pt);
+}
+
+void
+reservation_table::erase(::agent::id_type agent) {
+  auto it = agents_.find(agent);
+  if (it == agents_.end())
+    return;
+
+  // Another agent may have taken over one of these tiles since.
+  for (position_time pt : it->second) {
+    record const* r = find(pt);
+    if (r && r->agent == agent)
+      layers_[pt.time % layers_.size()].tiles.erase(pt.position());
+  }
+
+  agents_.erase(it);
+}
+
+void
+reservation_table::advance(tick_t now) {
+  if (now > now_) {
+    now_ = now;
+    for (layer& l : layers_)
+      if (l.used && l.tick < now_) {
+        l.tiles.release();
+        l.used = false;
+      }
+  }
+
+  // Layers recycle themselves; only the per-agent lists need retiring. Doing
+  // it once per turn of the ring keeps the cost per reservation constant.
+  if (now_ >= next_retirement_) {
+    retire();
+    next_retirement_ = now_ + std::max<std::size_t>(layers_.size(), 1);
+  }
+}
+
+std::size_t
+reservation_table::memory() const {
+  std::size_t result = layers_.capacity() * sizeof(layer);
+  for (layer const& l : layers_)
+    result += l.tiles.memory();
+
+  result += agents_.bucket_count() * sizeof(void*);
+  for (auto const& agent_reservations : agents_)
+    result += sizeof(agent_reservations) + sizeof(void*)
+      + agent_reservations.second.capacity() * sizeof(position_time);
+
+  return result;
+}
+
+auto
+reservation_table::writable_layer(tick_t t) -> layer& {
+  while (true) {
+    if (layers_.empty())
+      grow();
+
+    layer& l = layers_[t % layers_.size()];
+    if (l.used && l.tick == t)
+      return l;
+
+    if (!l.used || l.tick < now_) {
+      l.tiles.clear();
+      l.tick = t;
+      l.used = true;
+      return l;
+    }
+
+    // The layer still holds a tick that isn't past.
+    grow();
+  }
+}
+
+void
+reservation_table::grow() {
+  assert(map_);
+
+  std::vector<layer> old = std::move(layers_);
+  layers_ = std::vector<layer>(old.empty() ? horizon_ + 1 : 2 * old.size());
+
+  for (layer& l : old)
+    if (l.used && l.tick >= now_)
+      layers_[l.tick % layers_.size()] = std::move(l);
+
+  for (layer& l : layers_)
+    if (!l.used)
+      l.tiles.prepare(*map_);
+}
+
+void
+reservation_table::retire() {
+  for (auto it = agents_.begin(); it != agents_.end(); ) {
+    std::vector<position_time>& reservations = it->second;
+    auto past = std::remove_if(reservations.begin(), reservations.end(),
+                               [&] (position_time pt) {
+                                 return pt.time < now_;
+                               });
+    retired_ += reservations.end() - past;
+    reservations.erase(past, reservations.end());
+
+    if (reservations.empty())
+      it = agents_.erase(it);
+    else
+      ++it;
+  }
+}
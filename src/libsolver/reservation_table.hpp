@@ -0,0 +1,97 @@
+#ifndef RESERVATION_TABLE_HPP
+#define RESERVATION_TABLE_HPP
+
+#include "grid_table.hpp"
+#include "world.hpp"
+
+#include <boost/optional.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Tiles reserved by agents at given ticks. The table is a ring of layers, one
+// per tick, each a grid_table of the tiles reserved at that tick. Once a tick
+// is in the past, its layer's pages are freed and the layer is reused for a
+// later one. The ring starts with a layer for each tick up to the horizon, and
+// grows when reservations reach further ahead than it has layers for. Each
+// agent's reservations are listed too, so that they can be dropped without
+// scanning the table; entries of these lists that have passed are retired
+// every so many ticks, so the table's memory doesn't grow over long runs.
+class reservation_table {
+public:
+  struct record {
+    ::agent::id_type agent;
+    boost::optional<position> from;  // Agent's position the tick before.
+  };
+
+  // Use the table for the given map, with reservations reaching up to horizon
+  // ticks past the present. If it was used for another map before, it's
+  // emptied.
+  void
+  prepare(std::shared_ptr<map const> const& m, tick_t horizon);
+
+  record const*
+  find(position_time pt) const {
+    layer const* l = layer_for(pt.time);
+    return l ? l->tiles.find(pt.position()) : nullptr;
+  }
+
+  bool
+  count(position_time pt) const { return find(pt) != nullptr; }
+
+  // pt mustn't be reserved yet, nor be before the present. If it's reserved
+  // anyway, r replaces the old record.
+  void
+  insert(position_time pt, record r);
+
+  // Drop all reservations of the given agent that are still its own.
+  void
+  erase(::agent::id_type agent);
+
+  // Ticks before now are past and won't be looked up any more.
+  void
+  advance(tick_t now);
+
+  // Number of reservations retired because their tick had passed.
+  std::size_t retired() const { return retired_; }
+
+  // Approximate number of bytes allocated by the table.
+  std::size_t
+  memory() const;
+
+private:
+  struct layer {
+    tick_t tick = 0;
+    bool used = false;
+    grid_table<record> tiles;
+  };
+
+  std::shared_ptr<map const> map_;
+  tick_t horizon_ = 0;
+  std::vector<layer> layers_;  // Tick t is in layer t % layers_.size().
+  std::unordered_map<agent::id_type, std::vector<position_time>> agents_;
+  tick_t now_ = 0;
+  tick_t next_retirement_ = 0;
+  std::size_t retired_ = 0;
+
+  layer const*
+  layer_for(tick_t t) const {
+    if (layers_.empty())
+      return nullptr;
+
+    layer const& l = layers_[t % layers_.size()];
+    return l.used && l.tick == t ? &l : nullptr;
+  }
+
+  layer&
+  writable_layer(tick_t t);
+
+  void
+  grow();
+
+  void
+  retire();
+};
+
+#endif
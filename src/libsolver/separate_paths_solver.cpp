@@ -5,19 +5,23 @@
 #include "predictor.hpp"
 #include "whca.hpp"
 
+#include <algorithm>
+
 template <typename Derived>
 separate_paths_solver<Derived>::separate_paths_solver(
   log_sink& log,
   unsigned rejoin_limit,
   std::unique_ptr<predictor> predictor,
   unsigned obstacle_penalty,
-  double obstacle_threshold
+  double obstacle_threshold,
+  std::shared_ptr<landmarks const> landmarks
 )
   : log_(log)
   , rejoin_limit_(rejoin_limit)
   , predictor_(std::move(predictor))
   , obstacle_penalty_(obstacle_penalty)
   , obstacle_threshold_(obstacle_threshold)
+  , landmarks_(std::move(landmarks))
 { }
 
 static bool
@@ -36,13 +40,11 @@ separate_paths_solver<Derived>::step(
   if (predictor_)
     predictor_->update_obstacles(w);
 
-  std::unordered_map<agent::id_type, position> agents;
   std::vector<agent::id_type> agent_order;
   std::unordered_set<agent::id_type> finished_agents;
 
   for (auto const& pos_agent : w.agents()) {
     agent const& a = std::get<1>(pos_agent);
-    agents.insert({a.id(), std::get<0>(pos_agent)});
     agent_order.push_back(a.id());
 
     if (is_waiting_at_goal(a, paths_[a.id()]))
@@ -76,9 +78,18 @@ separate_paths_solver<Derived>::step(
       paths_[id].clear();
   }
 
+  std::vector<agent::id_type> replanned;
+  for (agent::id_type id : agent_order)
+    if (paths_[id].size() < 2)
+      replanned.push_back(id);
+  plan_ahead(replanned, w);
+
+  if (should_stop_)
+    return;
+
   for (agent::id_type id : agent_order) {
-    position const pos = agents[id];
-    agent const& agent = *w.get_agent(pos);
+    position const pos = *w.agent_position(id);
+    agent const& agent = w.get_agent(id);
 
     boost::optional<position> maybe_next = next_step(pos, w, rng);
     if (!maybe_next) {
@@ -242,14 +253,28 @@ separate_paths_solver<Derived>::rejoin_path(position from, world const& w,
   assert(w.get_agent(from));
   agent const& a = *w.get_agent(from);
 
-  auto as = derived()->make_rejoin_search(from, *to, w, a);
-  path<> join_path = as->find_path(
+  auto& as = derived()->rejoin_search(from, *to, w, a);
+  path<> join_path = as.find_path(
     w,
     [&] (position p) { return target_positions.count(p); },
     rejoin_limit_
   );
 
-  nodes_rejoin_ += as->nodes_expanded();
+  nodes_rejoin_ += as.nodes_expanded();
+
+  if (join_path.empty() && !should_stop_) {
+    join_path = rejoin_beyond_limit(from, *to, w);
+
+    // Cut it where it first meets the old path. It's stored goal first.
+    auto join = std::find_if(join_path.rbegin(), join_path.rend(),
+                             [&] (position p) {
+                               return target_positions.count(p);
+                             });
+    if (join == join_path.rend())
+      join_path.clear();
+    else
+      join_path.erase(join_path.begin(), join.base() - 1);
+  }
 
   if (join_path.empty() || should_stop_)
     return {};
@@ -1,6 +1,7 @@
 #ifndef SEPARATE_PATHS_SOLVER_HPP
 #define SEPARATE_PATHS_SOLVER_HPP
 
+#include "landmarks.hpp"
 #include "solvers.hpp"
 
 // Base class for decoupled solvers: LRA* and WHCA*. This calls the derived
@@ -14,7 +15,8 @@ public:
                         unsigned rejoin_limit,
                         std::unique_ptr<predictor> predictor,
                         unsigned obstacle_penalty,
-                        double obstacle_threshold);
+                        double obstacle_threshold,
+                        std::shared_ptr<landmarks const> landmarks);
 
   void
   step(world&, std::default_random_engine&) override;
@@ -45,6 +47,8 @@ protected:
   unsigned obstacle_penalty_ = 100;
   double obstacle_threshold_ = 0.1;
 
+  std::shared_ptr<landmarks const> landmarks_;
+
 private:
   using paths_map_type = std::unordered_map<agent::id_type, path<>>;
 
@@ -62,6 +66,11 @@ private:
   next_step(position, world const&, std::default_random_engine&,
             boost::optional<path<> const&> old_path = {});
 
+  // Called before any agent moves with the agents that will need a new path
+  // this step, in the order in which they'll get their turn.
+  virtual void
+  plan_ahead(std::vector<agent::id_type> const&, world const&) { }
+
   virtual void
   on_path_invalid(agent::id_type) { }
 
@@ -74,6 +83,14 @@ private:
   virtual path<>
   find_path(position, world const&, std::default_random_engine&) = 0;
 
+  // Called when the rejoin search couldn't get back to the old path within the
+  // rejoin limit. May return a path from `from` to `to`, the nearest free tile
+  // of the old path, found some other way.
+  virtual path<>
+  rejoin_beyond_limit(position /*from*/, position /*to*/, world const&) {
+    return {};
+  }
+
   boost::optional<path<>> rejoin_path(position from, world const& w,
                                       path<> const& old_path);
 };
@@ -0,0 +1,223 @@
+#ifndef SIPP_HPP
+#define SIPP_HPP
+
+#include "a_star.hpp"
+#include "grid_table.hpp"
+#include "world.hpp"
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <vector>
+
+// Safe Interval Path Planning (Phillips and Likhachev, 2011): a replacement for
+// the windowed space-time a_star with unitary step cost. Rather than a node for
+// every tile and every step, the times during which a tile may be occupied are
+// collapsed into safe intervals and the search has a node per tile and
+// interval, reached at the earliest possible time. Since waiting within an
+// interval is always possible, the earliest arrival is the best one.
+//
+// Passable has the same meaning as for a_star: passable(where, from, w, t)
+// tells whether the step from `from` to `where`, arriving t steps from the
+// start, is allowed. Waiting is a step where from == where; the safe intervals
+// are made of those times at which waiting would be allowed, and the step into
+// an interval is checked separately. Distance is the heuristic, consistent with
+// the unitary step cost.
+//
+// find_path gives a path of the same cost as a_star's find_path(w, window),
+// with one position per step. Only the cost is the same: ties between paths of
+// equal cost are broken differently (see entry), so the path itself may not be.
+template <typename Passable, typename Distance>
+class sipp_search {
+public:
+  void
+  reset(position from, world const& w, std::atomic<bool>& stop_flag,
+        Distance distance, Passable passable) {
+    if (map_ != w.map()) {
+      map_ = w.map();
+      tile_intervals_.prepare(*map_);
+    } else
+      tile_intervals_.clear();
+
+    intervals_.clear();
+    nodes_.clear();
+    heap_ = heap_type{};
+    expanded_ = 0;
+
+    from_ = from;
+    distance_.emplace(std::move(distance));
+    passable_.emplace(std::move(passable));
+    stop_flag_ = &stop_flag;
+  }
+
+  // Find a path to any position at which the agent can be `window` steps from
+  // the start.
+  path<>
+  find_path(world const& w, unsigned window) {
+    window_ = window;
+
+    unsigned const start_interval = intervals_of(from_, w, true).first;
+    push(from_, start_interval, 0, nullptr, w);
+
+    while (!heap_.empty()) {
+      if (*stop_flag_)
+        return {};
+
+      node* const current = heap_.top().n;
+      heap_.pop();
+
+      if (current->terminal)
+        return make_path(current);
+
+      interval& current_interval = intervals_[current->interval];
+      if (current_interval.closed)
+        continue;
+      current_interval.closed = true;
+      ++expanded_;
+
+      if (current_interval.end == window_)
+        push(current->pos, current->interval, window_, current, w, true);
+
+      for (position n : w.map()->adjacent(current->pos))
+        visit(current, n, w);
+    }
+
+    return {};
+  }
+
+  unsigned nodes_expanded() const { return expanded_; }
+
+private:
+  struct interval {
+    unsigned begin;
+    unsigned end;  // Inclusive; at most the window.
+    unsigned arrival = infinity;
+    bool closed = false;
+  };
+
+  struct node {
+    position pos;
+    unsigned interval;
+    unsigned arrival;
+    double f;
+    node* come_from;
+    bool terminal;  // Waiting here until the end of the window.
+  };
+
+  // Highest f last; among equal f, the latest arrival first.
+  struct entry {
+    node* n;
+
+    bool
+    operator < (entry const& other) const {
+      return n->f > other.n->f
+        || (n->f == other.n->f && n->arrival < other.n->arrival);
+    }
+  };
+
+  using heap_type = std::priority_queue<entry>;
+
+  std::shared_ptr<map const> map_;
+  position from_;
+  unsigned window_ = 0;
+  // Range of each tile's intervals in intervals_.
+  grid_table<std::pair<unsigned, unsigned>> tile_intervals_;
+  std::vector<interval> intervals_;
+  arena<node> nodes_;
+  heap_type heap_;
+  unsigned expanded_ = 0;
+  boost::optional<Distance> distance_;
+  boost::optional<Passable> passable_;
+  std::atomic<bool>* stop_flag_ = nullptr;
+
+  // Range of indices into intervals_ of the safe intervals of p, computing
+  // them if they haven't been yet. The agent's starting tile is always safe at
+  // the start.
+  std::pair<unsigned, unsigned>
+  intervals_of(position p, world const& w, bool start = false) {
+    if (auto const* range = tile_intervals_.find(p))
+      return *range;
+
+    unsigned const first = intervals_.size();
+    unsigned begin = infinity;
+    for (unsigned t = 0; t <= window_; ++t) {
+      bool const safe = (start && t == 0) || (*passable_)(p, p, w, t);
+      if (safe && begin == infinity)
+        begin = t;
+      else if (!safe && begin != infinity) {
+        intervals_.push_back({begin, t - 1});
+        begin = infinity;
+      }
+    }
+
+    if (begin != infinity)
+      intervals_.push_back({begin, window_});
+
+    std::pair<unsigned, unsigned> const result{first, intervals_.size()};
+    tile_intervals_.insert(p, result);
+    return result;
+  }
+
+  // Step from current into each safe interval of n reachable from current's,
+  // at the earliest time the step is allowed.
+  void
+  visit(node const* current, position n, world const& w) {
+    if (current->arrival == window_)
+      return;
+
+    unsigned const leave_by = intervals_[current->interval].end;
+
+    std::pair<unsigned, unsigned> const range = intervals_of(n, w);
+    for (unsigned i = range.first; i < range.second; ++i) {
+      interval const& target = intervals_[i];
+      if (target.closed || target.end <= current->arrival)
+        continue;
+      if (target.begin > leave_by + 1)
+        break;
+
+      unsigned const last = std::min(target.end, leave_by + 1);
+      for (unsigned t = std::max(target.begin, current->arrival + 1);
+           t <= last; ++t)
+        if ((*passable_)(n, current->pos, w, t)) {
+          push(n, i, t, current, w);
+          break;
+        }
+    }
+  }
+
+  void
+  push(position p, unsigned interval_index, unsigned arrival,
+       node const* come_from, world const& w, bool terminal = false) {
+    interval& i = intervals_[interval_index];
+    if (!terminal) {
+      if (arrival >= i.arrival)
+        return;
+      i.arrival = arrival;
+    }
+
+    node* const n = nodes_.construct(node{
+      p, interval_index, arrival, arrival + (*distance_)(p, w),
+      const_cast<node*>(come_from), terminal
+    });
+    heap_.push({n});
+  }
+
+  path<>
+  make_path(node const* end) const {
+    path<> result;
+    unsigned time = end->arrival + 1;
+    for (node const* n = end; n; n = n->come_from) {
+      // The agent arrived at n->pos at n->arrival and waited there until the
+      // next node.
+      for (unsigned t = n->arrival; t < time; ++t)
+        result.push_back(n->pos);
+      time = n->arrival;
+    }
+
+    return result;
+  }
+};
+
+#endif
@@ -34,27 +34,39 @@ std::unique_ptr<solver>
 make_lra(log_sink& log,
          unsigned rejoin_limit,
          std::unique_ptr<predictor> predictor,
-         unsigned obstacle_penalty, double obstacle_threshold) {
+         unsigned obstacle_penalty, double obstacle_threshold,
+         std::shared_ptr<landmarks const> landmarks,
+         bool incremental,
+         std::shared_ptr<cluster_hierarchy const> hierarchy) {
   return std::make_unique<lra>(log, rejoin_limit, std::move(predictor),
-                               obstacle_penalty, obstacle_threshold);
+                               obstacle_penalty, obstacle_threshold,
+                               std::move(landmarks), incremental,
+                               std::move(hierarchy));
 }
 
 std::unique_ptr<solver>
 make_whca(log_sink& log, unsigned window, unsigned rejoin_limit,
           std::unique_ptr<predictor> predictor, unsigned obstacle_penalty,
-          double obstacle_threshold) {
+          double obstacle_threshold,
+          std::shared_ptr<landmarks const> landmarks,
+          bool safe_intervals,
+          unsigned threads,
+          double heuristic_tolerance) {
   return std::make_unique<whca>(
     log, window, rejoin_limit, std::move(predictor), obstacle_penalty,
-    obstacle_threshold
+    obstacle_threshold, std::move(landmarks), safe_intervals, threads,
+    heuristic_tolerance
   );
 }
 
 std::unique_ptr<solver>
 make_od(unsigned window,
         std::unique_ptr<predictor> predictor, unsigned obstacle_penalty,
-        double obstacle_threshold) {
+        double obstacle_threshold,
+        std::shared_ptr<landmarks const> landmarks) {
   return std::make_unique<operator_decomposition>(window,
                                                   std::move(predictor),
                                                   obstacle_penalty,
-                                                  obstacle_threshold);
+                                                  obstacle_threshold,
+                                                  std::move(landmarks));
 }
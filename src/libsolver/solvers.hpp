@@ -12,6 +12,8 @@
 
 class predictor;
 class log_sink;
+class cluster_hierarchy;
+class landmarks;
 
 // Is the scenario finished? I.e. are all agents at their goals?
 bool
@@ -65,16 +67,24 @@ std::unique_ptr<solver>
 make_lra(log_sink&,
          unsigned rejoin_limit,
          std::unique_ptr<predictor> predictor,
-         unsigned obstacle_penalty, double obstacle_threshold);
+         unsigned obstacle_penalty, double obstacle_threshold,
+         std::shared_ptr<landmarks const> landmarks = {},
+         bool incremental = false,
+         std::shared_ptr<cluster_hierarchy const> hierarchy = {});
 
 std::unique_ptr<solver>
 make_whca(log_sink& log, unsigned window, unsigned rejoin_limit,
           std::unique_ptr<predictor> predictor, unsigned obstacle_penalty,
-          double obstacle_threshold);
+          double obstacle_threshold,
+          std::shared_ptr<landmarks const> landmarks = {},
+          bool safe_intervals = false,
+          unsigned threads = 1,
+          double heuristic_tolerance = 1.0);
 
 std::unique_ptr<solver>
 make_od(unsigned window,
         std::unique_ptr<predictor> predictor, unsigned obstacle_penalty,
-        double obstacle_threshold);
+        double obstacle_threshold,
+        std::shared_ptr<landmarks const> landmarks = {});
 
 #endif // SOLVERS_HPP
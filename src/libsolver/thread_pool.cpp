@@ -0,0 +1,57 @@
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool(unsigned threads) {
+  threads_.reserve(threads);
+  for (unsigned i = 1; i <= threads; ++i)
+    threads_.emplace_back(&thread_pool::work, this, i);
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  start_.notify_all();
+
+  for (std::thread& t : threads_)
+    t.join();
+}
+
+void
+thread_pool::run(std::function<void(unsigned)> const& job) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    job_ = &job;
+    running_ = threads_.size();
+    ++generation_;
+  }
+  start_.notify_all();
+
+  job(0);
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  done_.wait(lock, [&] { return running_ == 0; });
+  job_ = nullptr;
+}
+
+void
+thread_pool::work(unsigned index) {
+  unsigned done = 0;
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    start_.wait(lock, [&] { return stopping_ || generation_ != done; });
+    if (stopping_)
+      return;
+
+    done = generation_;
+    std::function<void(unsigned)> const& job = *job_;
+
+    lock.unlock();
+    job(index);
+    lock.lock();
+
+    if (--running_ == 0)
+      done_.notify_one();
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept waiting for jobs to run in parallel, so that running one doesn't
+// pay for starting and joining threads.
+class thread_pool {
+public:
+  // Pool of this many threads besides the caller's.
+  explicit
+  thread_pool(unsigned threads);
+  ~thread_pool();
+
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator = (thread_pool const&) = delete;
+
+  // Number of threads a job runs on, counting the caller's.
+  unsigned size() const { return threads_.size() + 1; }
+
+  // Call job(i) for each i in [0, size()), each on a different thread; job(0)
+  // is called on the caller's. Returns when all calls have. The job mustn't
+  // throw.
+  void
+  run(std::function<void(unsigned)> const& job);
+
+private:
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  std::function<void(unsigned)> const* job_ = nullptr;
+  unsigned generation_ = 0;  // Number of jobs started.
+  unsigned running_ = 0;
+  bool stopping_ = false;
+
+  void
+  work(unsigned index);
+};
+
+#endif
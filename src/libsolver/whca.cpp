@@ -2,46 +2,81 @@
 
 #include "predictor.hpp"
 
+#include <atomic>
+#include <cmath>
+
 whca::whca(log_sink& log, unsigned window,
            unsigned rejoin_limit,
            std::unique_ptr<predictor> predictor,
            unsigned obstacle_penalty,
-           double obstacle_threshold)
+           double obstacle_threshold,
+           std::shared_ptr<landmarks const> landmarks,
+           bool safe_intervals,
+           unsigned threads,
+           double heuristic_tolerance)
   : separate_paths_solver(log, rejoin_limit, std::move(predictor),
-                          obstacle_penalty, obstacle_threshold)
+                          obstacle_penalty, obstacle_threshold,
+                          std::move(landmarks))
+  , workspaces_(std::max(threads, 1u))
   , window_(window)
-{ }
+  , safe_intervals_(safe_intervals)
+  , heuristic_tolerance_(heuristic_tolerance)
+{
+  if (threads > 1) {
+    threads_ = std::make_unique<thread_pool>(threads - 1);
+    if (predictor_)
+      for (workspace& ws : workspaces_)
+        ws.reader = predictor_->make_reader();
+  }
+}
 
 std::vector<std::string>
 whca::stat_names() const {
   std::vector<std::string> result = separate_paths_solver::stat_names();
   result.insert(result.end(),
                 {"Primary nodes expanded", "Heuristic nodes expanded",
-                 "Total nodes expanded"});
+                 "Total nodes expanded", "Heuristic hits", "Heuristic misses",
+                 "Speculative plans used", "Speculative plans discarded",
+                 "Reservations retired", "Reservation memory"});
   return result;
 }
 
 std::vector<std::string>
 whca::stat_values() const {
+  workspace total;
+  for (workspace const& ws : workspaces_) {
+    total.nodes_primary += ws.nodes_primary;
+    total.nodes_heuristic += ws.nodes_heuristic;
+    total.heuristic_hits += ws.heuristic_hits;
+    total.heuristic_misses += ws.heuristic_misses;
+  }
+
   std::vector<std::string> result = separate_paths_solver::stat_values();
   result.insert(
     result.end(),
     {
-      std::to_string(nodes_primary_),
-      std::to_string(nodes_heuristic_),
-      std::to_string(nodes_primary_ + nodes_heuristic_),
+      std::to_string(total.nodes_primary),
+      std::to_string(total.nodes_heuristic),
+      std::to_string(total.nodes_primary + total.nodes_heuristic),
+      std::to_string(total.heuristic_hits),
+      std::to_string(total.heuristic_misses),
+      std::to_string(speculative_used_),
+      std::to_string(speculative_discarded_),
+      std::to_string(agent_reservations_.retired()),
+      std::to_string(agent_reservations_.memory())
     }
   );
   return result;
 }
 
 auto
-whca::make_rejoin_search(position from, position to, world const& w,
-                         agent const& agent)
-  -> std::unique_ptr<rejoin_search_type> {
-  return std::make_unique<rejoin_search_type>(
+whca::rejoin_search(position from, position to, world const& w,
+                    agent const& agent)
+  -> rejoin_search_type& {
+  agent_reservations_.prepare(w.map(), window_);
+  rejoin_search_.reset(
     from, to, w, should_stop_,
-    manhattan_distance_heuristic{to},
+    alt_heuristic{landmarks_for(landmarks_, w), to},
     predicted_cost(predictor_.get(), w.tick(), obstacle_penalty_),
     passable_if_not_predicted_obstacle(
       predictor_.get(),
@@ -49,31 +84,42 @@ whca::make_rejoin_search(position from, position to, world const& w,
       predictor_ ? obstacle_threshold_ : 1.0
     )
   );
+  return rejoin_search_;
 }
 
 whca::passable_if_not_reserved::passable_if_not_reserved(
-  reservation_table_type const& reservations,
+  reservation_table const& reservations,
   agent const& agent,
-  position from
+  position from,
+  std::vector<reservation_query>* queries
 )
   : reservations_(reservations)
   , agent_(agent)
   , from_(from)
+  , queries_(queries)
 { }
 
 bool
 whca::passable_if_not_reserved::operator () (
   position where, position from, world const& w, unsigned distance
 ) {
-  if (reservations_.count(position_time{where, w.tick() + distance}))
+  bool const result = check(where, from, w, distance);
+  if (queries_)
+    queries_->push_back({where, from, distance, result});
+  return result;
+}
+
+bool
+whca::passable_if_not_reserved::check(
+  position where, position from, world const& w, unsigned distance
+) const {
+  auto reserved = reservations_.find(position_time{where, w.tick() + distance});
+  if (reserved && reserved->agent != agent_.id())
     return false;
 
-  auto vacated = reservations_.find(
-    position_time{from, w.tick() + distance}
-  );
-  if (vacated != reservations_.end() &&
-      vacated->second.from &&
-      *vacated->second.from == where)
+  auto vacated = reservations_.find(position_time{from, w.tick() + distance});
+  if (vacated && vacated->agent != agent_.id()
+      && vacated->from && *vacated->from == where)
     return false;
 
   return w.get(where) == tile::free || !neighbours(where, from_);
@@ -82,27 +128,22 @@ whca::passable_if_not_reserved::operator () (
 void
 whca::reserve(agent::id_type a_id, path<> const& path,
               tick_t from) {
+  agent_reservations_.advance(from);
+
   for (tick_t distance = 0; distance < path.size(); ++distance) {
     position const p = path[path.size() - distance - 1];
     position_time const pt{p, from + distance};
 
-    assert(!agent_reservations_.count(pt));
-
     if (distance > 0)
-      agent_reservations_[pt] = {a_id, path[path.size() - distance]};
+      agent_reservations_.insert(pt, {a_id, path[path.size() - distance]});
     else
-      agent_reservations_[pt] = {a_id, boost::none};
+      agent_reservations_.insert(pt, {a_id, boost::none});
   }
 }
 
 void
 whca::unreserve(agent::id_type a_id) {
-  auto it = agent_reservations_.begin();
-  while (it != agent_reservations_.end())
-    if (it->second.agent == a_id)
-      it = agent_reservations_.erase(it);
-    else
-      ++it;
+  agent_reservations_.erase(a_id);
 }
 
 double
@@ -110,10 +151,62 @@ whca::hierarchical_distance::operator () (
   position from,
   world const& w
 ) {
-  if (from == h_search_.from())
+  if (table_) {
+    boost::optional<unsigned> d = table_->distance(from, *nodes_);
+    return d ? *d : infinity;
+  }
+
+  if (from == h_search_->from())
     return 0.0;
 
-  return h_search_.find_distance(from, w);
+  return h_search_->find_distance(from, w);
+}
+
+template <typename Unseen>
+bool
+whca::complete_along_distance_table::operator () (
+  position p, unsigned steps, world const& w, std::vector<position>& rest,
+  Unseen unseen
+) {
+  if (unsigned const* s = failed.find(p))
+    if (*s == steps)
+      return false;
+
+  boost::optional<unsigned> const d = table.distance(p, nodes);
+  if (!d || *d < window - steps)
+    return false;
+
+  position current = p;
+  unsigned current_distance = *d;
+  for (unsigned t = steps + 1; t <= window; ++t) {
+    // Of several ways down, the search would go on by the last one it pushes.
+    boost::optional<position> next;
+    for (position n : w.map()->adjacent(current)) {
+      boost::optional<unsigned> const n_distance = table.distance(n, nodes);
+      if (n_distance && *n_distance + 1 == current_distance
+          && unseen(n, t) && passable(n, current, w, t))
+        next = n;
+    }
+
+    if (!next) {
+      // The search will go on from p by these same steps, and completing from
+      // any of them would give up here too.
+      for (unsigned s = steps; s < t; ++s) {
+        position const q = s == steps ? p : rest[s - steps - 1];
+        if (unsigned* f = failed.find(q))
+          *f = s;
+        else
+          failed.insert(q, s);
+      }
+      return false;
+    }
+
+    --current_distance;
+    current = *next;
+    rest.push_back(current);
+  }
+
+  return true;
 }
 
 bool
@@ -128,48 +221,222 @@ whca::passable_if_not_predicted_obstacle::operator () (
         <= threshold_);
 }
 
+void
+whca::prepare(world const& w) {
+  agent_reservations_.prepare(w.map(), window_);
+  if (!predictor_ && (!distances_ || distances_->map() != w.map()))
+    distances_ = distance_cache::for_map(w.map());
+}
+
 path<>
 whca::find_path(position from, world const& w, std::default_random_engine&) {
   assert(w.get_agent(from));
   agent const& a = *w.get_agent(from);
+  prepare(w);
 
-  heuristic_map_.erase(a.id());
-  heuristic_search_type& h_search = heuristic_map_.emplace(
-    std::piecewise_construct,
-    std::forward_as_tuple(a.id()),
-    std::forward_as_tuple(a.target, from, w, should_stop_,
-                          manhattan_distance_heuristic{from},
-                          predicted_cost{predictor_.get(), w.tick(),
-                                         obstacle_penalty_})
-  ).first->second;
-  unsigned const old_h_search_nodes = h_search.nodes_expanded();
-
-  using search_type = a_star<
-    position,
-    position_successors,
-    passable_if_not_predicted_obstacle,
-    hierarchical_distance,
-    unitary_step_cost,
-    space_time_coordinate
-  >;
-  search_type as(
-    from, a.target, w, should_stop_,
-    hierarchical_distance(h_search),
-    unitary_step_cost{},
-    passable_if_not_predicted_obstacle(
-      predictor_.get(),
-      passable_if_not_reserved(agent_reservations_, a, from),
-      predictor_ ? obstacle_threshold_ : 1.0
-    )
+  auto speculative = speculative_plans_.find(a.id());
+  if (speculative != speculative_plans_.end()) {
+    speculative_plan speculation = std::move(speculative->second);
+    speculative_plans_.erase(speculative);
+
+    if (speculation.tick == w.tick() && speculation.from == from
+        && speculation_valid(speculation, a, w)) {
+      ++speculative_used_;
+      return std::move(speculation.result);
+    }
+
+    ++speculative_discarded_;
+  }
+
+  return plan(a, from, w, workspaces_.front(), nullptr);
+}
+
+// Called with prepare already done; may run in several threads at once, each
+// with its own workspace.
+path<>
+whca::plan(agent const& a, position from, world const& w, workspace& ws,
+           speculative_plan* speculation) {
+  predictor* p = predictor_.get();
+  std::vector<reservation_query>* queries = nullptr;
+  if (speculation) {
+    queries = &speculation->queries;
+    if (predictor_)
+      p = ws.reader.get();
+
+    if (predictor_ && predictor_->depends_on_agents()) {
+      ws.recorder.source = ws.reader.get();
+      ws.recorder.queries = &speculation->predictions;
+      p = &ws.recorder;
+    }
+  }
+
+  // Without a predictor, distances to the goal don't depend on time and can be
+  // shared through the cache. Otherwise each agent needs its own search.
+  std::shared_ptr<distance_table> table;
+  heuristic_search_type* h_search = nullptr;
+  unsigned table_nodes = 0;
+  unsigned heuristic_nodes_before = 0;
+
+  if (!predictor_)
+    table = distances_->get(a.target);
+  else {
+    h_search = &heuristic_search(a, from, w, ws, p);
+    heuristic_nodes_before = h_search->nodes_expanded();
+  }
+
+  hierarchical_distance const distance =
+    table ? hierarchical_distance(*table, table_nodes)
+          : hierarchical_distance(*h_search);
+  passable_if_not_predicted_obstacle const passable(
+    p,
+    passable_if_not_reserved(agent_reservations_, a, from, queries),
+    predictor_ ? obstacle_threshold_ : 1.0
   );
-  path<> new_path = as.find_path(w, window_);
 
-  nodes_primary_ += as.nodes_expanded();
-  nodes_heuristic_ += h_search.nodes_expanded() - old_h_search_nodes;
+  path<> new_path;
+  if (safe_intervals_) {
+    ws.sipp_search.reset(from, w, should_stop_, distance, passable);
+    new_path = ws.sipp_search.find_path(w, window_);
+    ws.nodes_primary += ws.sipp_search.nodes_expanded();
+  } else {
+    ws.search.reset(from, a.target, w, should_stop_, distance,
+                    unitary_step_cost{}, passable);
+
+    // The distances in the table are exact, so the search can be cut short
+    // where it could follow them. Costs from the heuristic searches include
+    // predicted obstacles and can't be followed step by step like that.
+    if (table) {
+      if (ws.failed_map != w.map()) {
+        ws.failed_map = w.map();
+        ws.failed.prepare(*ws.failed_map);
+      } else
+        ws.failed.clear();
+
+      new_path = ws.search.find_path_completing(
+        w, window_,
+        complete_along_distance_table{*table, table_nodes, passable,
+                                      ws.failed, window_}
+      );
+    } else
+      new_path = ws.search.find_path(w, window_);
+
+    ws.nodes_primary += ws.search.nodes_expanded();
+  }
+  ws.nodes_heuristic += h_search
+    ? h_search->nodes_expanded() - heuristic_nodes_before
+    : table_nodes;
 
   return new_path;
 }
 
+bool
+whca::speculation_valid(speculative_plan const& plan, agent const& a,
+                        world const& w) const {
+  passable_if_not_reserved passable(agent_reservations_, a, plan.from);
+  for (reservation_query const& q : plan.queries)
+    if (passable(q.where, q.from, w, q.distance) != q.passable)
+      return false;
+
+  // Asked in the same order as the search did, so that the predictor ends up
+  // as it would have had the search been run now.
+  for (prediction_query const& q : plan.predictions)
+    if (predictor_->predict_obstacle(q.where) != q.probability)
+      return false;
+
+  return true;
+}
+
+void
+whca::plan_ahead(std::vector<agent::id_type> const& agents, world const& w) {
+  speculative_plans_.clear();
+  if (!threads_ || agents.size() < 2)
+    return;
+
+  // If the predictor depends on agents, an agent's heuristic search could be
+  // extended with predictions that no longer hold by its turn. A rebuilt search
+  // would just be thrown away then, but a reused one would keep them.
+  if (predictor_ && predictor_->depends_on_agents()
+      && heuristic_tolerance_ >= 0.0)
+    return;
+
+  prepare(w);
+
+  // The threads mustn't insert into heuristic_map_.
+  if (predictor_)
+    for (agent::id_type id : agents)
+      heuristic_map_[id];
+
+  std::vector<speculative_plan> plans(agents.size());
+  std::atomic<std::size_t> next{0};
+  auto work = [&] (workspace& ws) {
+    for (std::size_t i = next++; i < agents.size(); i = next++) {
+      position const from = *w.agent_position(agents[i]);
+      plans[i].tick = w.tick();
+      plans[i].from = from;
+      plans[i].result = plan(w.get_agent(agents[i]), from, w, ws, &plans[i]);
+    }
+  };
+
+  threads_->run([&] (unsigned t) { work(workspaces_[t]); });
+
+  if (should_stop_)
+    return;
+
+  for (std::size_t i = 0; i < agents.size(); ++i)
+    speculative_plans_.emplace(agents[i], std::move(plans[i]));
+}
+
+auto
+whca::heuristic_search(agent const& a, position from, world const& w,
+                       workspace& ws, predictor* p)
+  -> heuristic_search_type& {
+  auto it = heuristic_map_.find(a.id());
+  heuristic_record& record =
+    it != heuristic_map_.end() ? it->second : heuristic_map_[a.id()];
+
+  if (record.valid && record.target == a.target
+      && heuristic_tolerance_ >= 0.0) {
+    // Nodes still to be expanded are costed from now on, which is as far back
+    // as the predictor can tell.
+    record.search.step_cost() = predicted_cost{p, w.tick(), obstacle_penalty_};
+
+    unsigned const nodes_before = record.search.nodes_expanded();
+    double const drift = heuristic_drift(record.search, from, w, p);
+    ws.nodes_heuristic += record.search.nodes_expanded() - nodes_before;
+
+    if (drift <= heuristic_tolerance_) {
+      ++ws.heuristic_hits;
+      return record.search;
+    }
+  }
+
+  ++ws.heuristic_misses;
+  record.search.reset(a.target, from, w, should_stop_,
+                      alt_heuristic{landmarks_for(landmarks_, w), from},
+                      predicted_cost{p, w.tick(), obstacle_penalty_});
+  record.target = a.target;
+  record.valid = true;
+  return record.search;
+}
+
+double
+whca::heuristic_drift(heuristic_search_type& search, position from,
+                      world const& w, predictor* p) const {
+  search.find_distance(from, w);
+
+  predicted_cost const now{p, w.tick(), obstacle_penalty_};
+  double result = 0.0;
+  unsigned steps = 0;
+  search.foreach_step_to(
+    from,
+    [&] (position a, position b, unsigned distance, double cost) {
+      if (steps++ < window_)
+        result += std::abs(now(a, b, distance) - cost);
+    }
+  );
+  return result;
+}
+
 void
 whca::on_path_invalid(agent::id_type agent) {
   unreserve(agent);
@@ -177,6 +444,7 @@ whca::on_path_invalid(agent::id_type agent) {
 
 void
 whca::on_path_found(agent::id_type agent, path<> const& path, world const& w) {
+  agent_reservations_.prepare(w.map(), window_);
   reserve(agent, path, w.tick());
 }
 
@@ -4,8 +4,14 @@
 #include "separate_paths_solver.hpp"
 
 #include "a_star.hpp"
+#include "distance_cache.hpp"
+#include "predictor.hpp"
+#include "reservation_table.hpp"
+#include "sipp.hpp"
+#include "thread_pool.hpp"
 
-class predicted_cost;
+#include <unordered_map>
+#include <vector>
 
 class whca : public separate_paths_solver<whca> {
   class passable_if_not_predicted_obstacle;
@@ -15,15 +21,23 @@ public:
     position,
     position_successors,
     passable_if_not_predicted_obstacle,
-    manhattan_distance_heuristic,
+    alt_heuristic,
     predicted_cost,
-    space_time_coordinate
+    space_time_coordinate,
+    position_distance_storage,
+    always_close<position_time>,
+    coord_open_set,
+    radix_queue
   >;
 
   whca(log_sink& log, unsigned window, unsigned rejoin_limit,
        std::unique_ptr<predictor> predictor,
        unsigned obstacle_penalty,
-       double obstacle_threshold);
+       double obstacle_threshold,
+       std::shared_ptr<landmarks const> landmarks = {},
+       bool safe_intervals = false,
+       unsigned threads = 1,
+       double heuristic_tolerance = 1.0);
 
   std::string name() const override { return "WHCA*"; }
   void window(unsigned new_window) override { window_ = new_window; }
@@ -34,51 +48,112 @@ public:
   std::vector<std::string>
   stat_values() const override;
 
-  std::unique_ptr<rejoin_search_type>
-  make_rejoin_search(position from, position to, world const& w,
-                     agent const& agent);
+  // Reset the rejoin search for the given agent and return it.
+  rejoin_search_type&
+  rejoin_search(position from, position to, world const& w,
+                agent const& agent);
 
 private:
-  struct reservation_table_record {
-    ::agent::id_type agent;
-    boost::optional<position> from;
-  };
-
-  using reservation_table_type =
-    std::unordered_map<position_time, reservation_table_record>;
-
   using heuristic_search_type = a_star<
     position, position_successors, always_passable,
-    manhattan_distance_heuristic, predicted_cost
+    alt_heuristic, predicted_cost, space_coordinate<>,
+    grid_distance_storage, always_close<position>, grid_open_set,
+    radix_queue, grid_closed_set
   >;
-  using heuristic_map_type = std::map<agent::id_type, heuristic_search_type>;
 
+  // An agent's heuristic search, kept across replans while the agent's target
+  // stays the same and the predictions over its next window of steps haven't
+  // changed much. When it's reused, its costs are taken to start from the tick
+  // of the replan.
+  struct heuristic_record {
+    heuristic_search_type search;
+    position target;
+    bool valid = false;
+  };
+  using heuristic_map_type = std::map<agent::id_type, heuristic_record>;
+
+  // A reservation check made by a search, with its answer.
+  struct reservation_query {
+    position where;
+    position from;
+    unsigned distance;
+    bool passable;
+  };
+
+  // Likewise for a prediction.
+  struct prediction_query {
+    position_time where;
+    double probability;
+  };
+
+  // Passes predictions on from source, noting each one down.
+  struct recording_predictor : predictor {
+    predictor* source = nullptr;
+    std::vector<prediction_query>* queries = nullptr;
+
+    void update_obstacles(world const&) override { }
+
+    double
+    predict_obstacle(position_time where) override {
+      double const result = source->predict_obstacle(where);
+      queries->push_back({where, result});
+      return result;
+    }
+
+    std::unordered_map<position_time, double>
+    field() const override { return source->field(); }
+
+    bool
+    depends_on_agents() const override { return source->depends_on_agents(); }
+
+    std::unique_ptr<predictor>
+    make_reader() const override { return source->make_reader(); }
+  };
+
+  // The agent's own reservations are ignored: they're dropped before it
+  // searches for a new path anyway, except when the search is speculative. If
+  // queries is given, each check is appended to it.
   class passable_if_not_reserved {
   public:
-    passable_if_not_reserved(reservation_table_type const& reservations,
+    passable_if_not_reserved(reservation_table const& reservations,
                              agent const& agent,
-                             position from);
+                             position from,
+                             std::vector<reservation_query>* queries = nullptr);
     bool operator () (position where, position from, world const& w,
                       unsigned distance);
 
   private:
-    reservation_table_type const& reservations_;
+    reservation_table const& reservations_;
     agent const& agent_;
     position from_;
+    std::vector<reservation_query>* queries_;
+
+    bool
+    check(position where, position from, world const& w,
+          unsigned distance) const;
   };
 
   void reserve(agent::id_type for_agent, path<> const&, tick_t from);
   void unreserve(agent::id_type);
 
+  // True distance to the goal, either from the agent's heuristic search or,
+  // when steps have uniform cost, from the shared distance table.
   struct hierarchical_distance {
     hierarchical_distance(heuristic_search_type& h_search)
-      : h_search_(h_search)
+      : h_search_(&h_search)
+    { }
+
+    hierarchical_distance(distance_table& table, unsigned& nodes)
+      : table_(&table)
+      , nodes_(&nodes)
     { }
 
     double operator () (position from, world const& w);
 
   private:
-    heuristic_search_type& h_search_;
+    heuristic_search_type* h_search_ = nullptr;
+    distance_table* table_ = nullptr;
+    unsigned* nodes_ = nullptr;
   };
 
   struct passable_if_not_predicted_obstacle {
@@ -99,11 +174,117 @@ private:
     double threshold_;
   };
 
-  reservation_table_type agent_reservations_;
+  using search_type = a_star<
+    position,
+    position_successors,
+    passable_if_not_predicted_obstacle,
+    hierarchical_distance,
+    unitary_step_cost,
+    space_time_coordinate,
+    position_distance_storage,
+    always_close<position_time>,
+    coord_open_set,
+    bucket_queue
+  >;
+
+  // Finishes a node of search_type by following the distance table down to the
+  // goal. Each step down keeps f the same, and the search's queue takes the
+  // last node pushed of the lowest f first. So if the goal is no closer than
+  // the end of the window, the search would itself go on by the last step down
+  // it can push, and so on to the end of the window, without expanding
+  // anything else. The completion takes those same steps and gives up where
+  // there are none, leaving the node to the search, so the path found is the
+  // plain search's. Closer to the goal, the search would look at other ways of
+  // waiting out the window, so such nodes are left to it too.
+  struct complete_along_distance_table {
+    distance_table& table;
+    unsigned& nodes;
+    passable_if_not_predicted_obstacle passable;
+    grid_table<unsigned>& failed;  // Step at which a completion that gave up
+                                   // went through each tile.
+    unsigned window;
+
+    template <typename Unseen>
+    bool operator () (position p, unsigned steps, world const& w,
+                      std::vector<position>& rest, Unseen unseen);
+  };
+
+  // Used instead of search_type when safe_intervals_ is set.
+  using sipp_search_type =
+    sipp_search<passable_if_not_predicted_obstacle, hierarchical_distance>;
+
+  // Searches and counters for planning one agent's path. There is one per
+  // thread; the first one is also used when planning sequentially. When there
+  // are several threads, each workspace also has its own reader of the
+  // predictor for speculative plans.
+  struct workspace {
+    std::unique_ptr<::predictor> reader;
+    recording_predictor recorder;
+    search_type search;
+    sipp_search_type sipp_search;
+    std::shared_ptr<::map const> failed_map;
+    grid_table<unsigned> failed;
+    unsigned nodes_primary = 0;
+    unsigned nodes_heuristic = 0;
+    unsigned heuristic_hits = 0;
+    unsigned heuristic_misses = 0;
+  };
+
+  // A path found ahead of the agent's turn, against the reservations and
+  // predictions as they were at the start of the step. It can be used if every
+  // check and prediction made by the search still gives the same answer when
+  // the agent's turn comes; the search would then find the same path again.
+  // Predictions are only noted down if they may change as agents move
+  // meanwhile.
+  struct speculative_plan {
+    tick_t tick;
+    position from;
+    path<> result;
+    std::vector<reservation_query> queries;
+    std::vector<prediction_query> predictions;
+  };
+
+  reservation_table agent_reservations_;
   heuristic_map_type heuristic_map_;
+  std::shared_ptr<distance_cache> distances_;
+  std::vector<workspace> workspaces_;
+  std::unordered_map<agent::id_type, speculative_plan> speculative_plans_;
+  rejoin_search_type rejoin_search_;
   unsigned window_;
-  unsigned nodes_primary_ = 0;
-  unsigned nodes_heuristic_ = 0;
+  bool safe_intervals_;
+  double heuristic_tolerance_;  // Negative to rebuild at every replan.
+  unsigned speculative_used_ = 0;
+  unsigned speculative_discarded_ = 0;
+
+  std::unique_ptr<thread_pool> threads_;  // Only if there's more than one.
+
+  void
+  prepare(world const& w);
+
+  heuristic_search_type&
+  heuristic_search(agent const& a, position from, world const& w,
+                   workspace& ws, predictor* p);
+
+  // Total change in the step costs of the first window of steps of the search's
+  // way from the agent at `from` to its target, between when the search costed
+  // them and now.
+  double
+  heuristic_drift(heuristic_search_type& search, position from, world const& w,
+                  predictor* p) const;
+
+  // Plan the agent's path now, or speculatively if speculation is given, in
+  // which case what the search is told is noted down in it.
+  path<>
+  plan(agent const& a, position from, world const& w, workspace& ws,
+       speculative_plan* speculation);
+
+  bool
+  speculation_valid(speculative_plan const& plan, agent const& a,
+                    world const& w) const;
+
+  void
+  plan_ahead(std::vector<agent::id_type> const& agents,
+             world const& w) override;
 
   path<> find_path(position, world const&,
                    std::default_random_engine&) override;
@@ -1,13 +1,16 @@
 #include "world.hpp"
 
-#include <boost/algorithm/string/trim.hpp>
+#include "action.hpp"
+#include "json.hpp"
+
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <ctime>
 #include <fstream>
 #include <iterator>
 #include <limits>
@@ -142,10 +145,131 @@ operator << (std::ostream& out, position_time pt) {
   return out << "[" << pt.x << ", " << pt.y << "]@" << pt.time;
 }
 
+static char const map_cache_magic[8] = {'d', 'a', 'm', 'a', 'p', '\0', '\0', 1};
+
+static void
+write_le(std::ostream& out, std::uint64_t value, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; ++i)
+    out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+static std::uint64_t
+read_le(char const* in, unsigned bytes) {
+  std::uint64_t result = 0;
+  for (unsigned i = 0; i < bytes; ++i)
+    result |= std::uint64_t{static_cast<unsigned char>(in[i])} << (8 * i);
+  return result;
+}
+
+// Read the rest of a stream into a string in one go.
+static std::string
+read_rest(std::istream& in) {
+  std::streampos const start = in.tellg();
+  in.seekg(0, std::ios::end);
+  std::streamoff const size = in.tellg() - start;
+  in.seekg(start);
+
+  std::string result(size, '\0');
+  in.read(&result[0], size);
+  result.resize(in.gcount());
+  return result;
+}
+
+// Load the binary cache. Returns null if the cache can't be used.
+static std::shared_ptr<map>
+load_map_cache(std::string const& cache_filename,
+               std::string const& map_filename) {
+  std::ifstream in{cache_filename, std::ios::binary};
+  if (!in)
+    return {};
+
+  std::string const data = read_rest(in);
+  std::size_t const header_size = sizeof(map_cache_magic) + 8;
+  if (data.size() < header_size
+      || !std::equal(std::begin(map_cache_magic), std::end(map_cache_magic),
+                     data.begin()))
+    return {};
+
+  auto const width = (map::coord_type) read_le(data.data() + 8, 4);
+  auto const height = (map::coord_type) read_le(data.data() + 12, 4);
+  map::coord_type const words_per_row =
+    (width + map::word_bits - 1) / map::word_bits;
+  if (data.size() != header_size + 8 * words_per_row * height)
+    return {};
+
+  std::vector<tile> tiles(width * height);
+  char const* words = data.data() + header_size;
+  for (map::coord_type y = 0; y < height; ++y)
+    for (map::coord_type w = 0; w < words_per_row; ++w) {
+      map::word_type const word = read_le(words, 8);
+      words += 8;
+
+      map::coord_type const end_x = std::min(width, (w + 1) * map::word_bits);
+      for (map::coord_type x = w * map::word_bits; x < end_x; ++x)
+        tiles[y * width + x] =
+          (word >> (x % map::word_bits)) & 1 ? tile::free : tile::wall;
+    }
+
+  return std::make_shared<map>(width, height, std::move(tiles), map_filename);
+}
+
+std::string
+map_cache_filename(std::string const& map_filename) {
+  return map_filename + ".cache";
+}
+
+bool
+map_cache_current(std::string const& map_filename) {
+  namespace fs = boost::filesystem;
+
+  boost::system::error_code ec;
+  std::time_t const cache_time =
+    fs::last_write_time(map_cache_filename(map_filename), ec);
+  if (ec)
+    return false;
+
+  std::time_t const map_time = fs::last_write_time(map_filename, ec);
+  return !ec && cache_time >= map_time;
+}
+
+void
+save_map_cache(map const& m) {
+  namespace fs = boost::filesystem;
+
+  // Write to a temporary file first so that concurrent readers never see a
+  // partially written cache.
+  std::string const filename = map_cache_filename(m.original_filename());
+  fs::path const temp =
+    fs::path{filename}.parent_path() / fs::unique_path("%%%%%%%%.tmp");
+
+  {
+    std::ofstream out{temp.string(), std::ios::binary};
+    out.write(map_cache_magic, sizeof(map_cache_magic));
+    write_le(out, m.width(), 4);
+    write_le(out, m.height(), 4);
+
+    for (map::coord_type y = 0; y < m.height(); ++y)
+      for (map::coord_type w = 0; w < m.words_per_row(); ++w)
+        write_le(out, m.passable_row(y)[w], 8);
+
+    if (!out) {
+      out.close();
+      fs::remove(temp);
+      throw std::runtime_error{"Could not write map cache " + filename};
+    }
+  }
+
+  fs::rename(temp, filename);
+}
+
 std::shared_ptr<map>
 load_map(std::string const& filename) {
   using namespace std::string_literals;
 
+  if (map_cache_current(filename))
+    if (auto result = load_map_cache(map_cache_filename(filename), filename))
+      return result;
+
   std::ifstream in{filename};
 
   if (!in)
@@ -162,27 +286,103 @@ load_map(std::string const& filename) {
 
   expect_word(in, "map");
 
-  auto result = std::make_shared<map>(width, height, filename);
+  std::string const body = read_rest(in);
+  std::vector<tile> tiles(width * height, tile::free);
+
+  // Translation table from characters to tiles. Characters that aren't valid
+  // tiles translate to invalid.
+  static tile const invalid = static_cast<tile>(-1);
+  static std::array<tile, 256> const translation = [] {
+    std::array<tile, 256> result;
+    result.fill(invalid);
+    for (unsigned c = 0; c < 256; ++c)
+      if (is_tile_char(c))
+        result[c] = char_to_tile(c);
+    return result;
+  }();
+
+  std::size_t i = 0;
+  std::size_t const max = tiles.size();
+
+  std::size_t line_begin = 0;
+  while (line_begin < body.size()) {
+    std::size_t line_end = body.find('\n', line_begin);
+    if (line_end == std::string::npos)
+      line_end = body.size();
+
+    for (std::size_t j = line_begin; j < line_end; ++j) {
+      tile const t = translation[static_cast<unsigned char>(body[j])];
+      if (t == invalid)
+        throw bad_world_format{"Not a valid tile character: "s + body[j]};
+
+      if (i >= max)
+        throw bad_world_format{"Too many tiles"};
+
+      tiles[i++] = t;
+    }
 
-  map::coord_type i = 0;
-  map::coord_type max = width * height;
+    line_begin = line_end + 1;
+  }
 
-  char c;
-  while (in && (c = in.get()) != std::ifstream::traits_type::eof()) {
-    if (c == '\n')
-      continue;
+  return std::make_shared<map>(width, height, std::move(tiles), filename);
+}
 
-    if (!is_tile_char(c))
-      throw bad_world_format{"Not a valid tile character: "s + c};
+map::map(coord_type width, coord_type height, std::vector<tile> tiles,
+         std::string const& filename)
+  : tiles_(std::move(tiles))
+  , width_{width}
+  , height_{height}
+  , words_per_row_{(width + word_bits - 1) / word_bits}
+  , passable_(words_per_row_ * height)
+  , filename_{filename}
+{
+  assert(tiles_.size() == (std::size_t) (width * height));
+
+  tile const* t = tiles_.data();
+  for (coord_type y = 0; y < height; ++y) {
+    word_type* row = &passable_[y * words_per_row_];
+    for (coord_type x = 0; x < width; ++x, ++t)
+      row[x / word_bits] |= word_type(*t != tile::wall) << (x % word_bits);
+  }
 
-    if (i >= max)
-      throw bad_world_format{"Too many tiles"};
+  build_adjacency();
+}
 
-    result->put(i % width, i / width, char_to_tile(c));
-    ++i;
+void
+map::build_adjacency() {
+  auto bit = [] (word_type const* row, coord_type x) {
+    return (row[x / word_bits] >> (x % word_bits)) & 1;
+  };
+
+  adjacency_offsets_.resize(width_ * height_ + 1);
+  adjacency_.clear();
+
+  for (coord_type y = 0; y < height_; ++y) {
+    word_type const* row = passable_row(y);
+    word_type const* above = y > 0 ? passable_row(y - 1) : nullptr;
+    word_type const* below = y + 1 < height_ ? passable_row(y + 1) : nullptr;
+
+    for (coord_type x = 0; x < width_; ++x) {
+      adjacency_offsets_[y * width_ + x] = adjacency_.size();
+
+      // Walls have no successors; nothing ever stands on them.
+      if (!bit(row, x))
+        continue;
+
+      // Same order as all_directions.
+      if (above && bit(above, x))
+        adjacency_.push_back({x, y - 1});
+      if (x + 1 < width_ && bit(row, x + 1))
+        adjacency_.push_back({x + 1, y});
+      if (below && bit(below, x))
+        adjacency_.push_back({x, y + 1});
+      if (x > 0 && bit(row, x - 1))
+        adjacency_.push_back({x - 1, y});
+    }
   }
 
-  return result;
+  adjacency_offsets_.back() = adjacency_.size();
+  adjacency_stale_ = false;
 }
 
 bool
@@ -196,6 +396,14 @@ in_bounds(int x, int y, map const& m) {
   return in_bounds({x, y}, m);
 }
 
+static void
+set_directory_entry(world::id_directory& directory, unsigned id,
+                    boost::optional<position> p) {
+  if (id >= directory.size())
+    directory.resize(id + 1);
+  directory[id] = p;
+}
+
 world::world(const std::shared_ptr<::map const>& m,
              ::obstacle_settings settings,
              ::agent_settings agents,
@@ -205,16 +413,30 @@ world::world(const std::shared_ptr<::map const>& m,
   , tick_(tick)
   , obstacle_settings_(std::move(settings))
   , agent_settings_(agents)
-{ }
+{
+  occupancy_.reserve(map_->width() * map_->height());
+  for (map::value_type const& t : *map_)
+    occupancy_.push_back({t.tile, 0});
+
+  for (auto const& pos_obstacle : obstacles_) {
+    occupancy_at(pos_obstacle.first) =
+      {tile::obstacle, pos_obstacle.second.id()};
+    set_obstacle_position(pos_obstacle.second.id(), pos_obstacle.first);
+    schedule(pos_obstacle.first, pos_obstacle.second);
+  }
+
+  if (obstacle_settings_.mode == obstacle_mode::spawn_to_goal
+      && !obstacle_settings_.goal_points.empty())
+    goal_distance();
+}
 
 static std::vector<position>
 valid_directions(position p, world const& w) {
   std::vector<position> result;
-  for (auto d : all_directions) {
-    position q = translate(p, d);
-    if (in_bounds(q, *w.map()) && traversable(w.map()->get(q)))
-      result.push_back(q);
-  }
+  unsigned const passable = w.map()->passable_neighbours(p);
+  for (auto d : all_directions)
+    if (passable & (1u << (unsigned) d))
+      result.push_back(translate(p, d));
 
   return result;
 }
@@ -239,41 +461,60 @@ move_random(obstacle o, position pos, world& w, std::default_random_engine& rng)
   w.put_obstacle(dest, o);
 }
 
+static unsigned const unreachable = std::numeric_limits<unsigned>::max();
+
+// Multi-source breadth-first search from all goal points over the static map.
+static std::vector<unsigned>
+goal_distances(map const& m, std::unordered_set<position> const& goal_points) {
+  std::vector<unsigned> result(m.width() * m.height(), unreachable);
+  std::vector<position> queue;
+  queue.reserve(result.size());
+
+  for (position g : goal_points)
+    if (m.passable(g) && result[g.y * m.width() + g.x] == unreachable) {
+      result[g.y * m.width() + g.x] = 0;
+      queue.push_back(g);
+    }
+
+  for (std::size_t i = 0; i < queue.size(); ++i) {
+    position const p = queue[i];
+    unsigned const d = result[p.y * m.width() + p.x] + 1;
+
+    for (position n : m.adjacent(p)) {
+      unsigned& n_dist = result[n.y * m.width() + n.x];
+      if (n_dist == unreachable) {
+        n_dist = d;
+        queue.push_back(n);
+      }
+    }
+  }
+
+  return result;
+}
+
 static void
 move_to_goal(obstacle o, position pos, world& w,
-             std::unordered_set<position> const& goal_points,
+             std::vector<unsigned> const& goal_distance,
              std::default_random_engine& rng) {
-  if (goal_points.empty())
-    throw std::runtime_error{
-      "Move-to-goal mode selected, but no goal points defined"
-    };
+  auto const distance_at = [&] (position p) {
+    return goal_distance[p.y * w.map()->width() + p.x];
+  };
 
-  if (goal_points.count(pos)) {
+  unsigned const d = distance_at(pos);
+  if (d == 0) {
     w.remove_obstacle(pos);
     return;
   }
 
-  position nearest_goal = *goal_points.begin();
-  unsigned nearest_distance = std::numeric_limits<unsigned>::max();
-  for (position g : goal_points)
-    if (distance(pos, g) < nearest_distance) {
-      nearest_goal = g;
-      nearest_distance = distance(pos, g);
-    }
-
-  int dx = nearest_goal.x - pos.x;
-  int dy = nearest_goal.y - pos.y;
-
-  auto sgn = [] (int x) { return x > 0 ? 1 : x < 0 ? -1 : 0; };
-
+  // Step to the first free neighbour that is closer to a goal. If there is
+  // none, or no goal can be reached at all, stay in place.
   position next = pos;
-  if (std::abs(dx) > std::abs(dy))
-    next.x += sgn(dx);
-  else
-    next.y += sgn(dy);
-
-  if (w.get(next) != tile::free)
-    next = pos;
+  if (d != unreachable)
+    for (position n : w.map()->adjacent(pos))
+      if (distance_at(n) == d - 1 && w.get(n) == tile::free) {
+        next = n;
+        break;
+      }
 
   w.remove_obstacle(pos);
   o.next_move = w.tick() + std::max(1, (int) o.move_distrib(rng));
@@ -286,28 +527,63 @@ make_normal(normal_distribution d) {
   return std::normal_distribution<>(d.mean, d.std_dev);
 }
 
-static void
-make_obstacles(world& w, obstacle_settings settings,
-               std::default_random_engine& rng) {
-  auto rand = [&] { return std::generate_canonical<double, 32>(rng); };
+void
+world::spawn_obstacles(std::default_random_engine& rng) {
+  double const probability = obstacle_settings_.tile_probability;
+  if (probability <= 0.0)
+    return;
+
   std::normal_distribution<> time_to_move =
-    make_normal(settings.move_probability);
-
-  std::unordered_set<position> spawn_candidates = settings.spawn_points;
-  if (spawn_candidates.empty())
-    for (map::value_type const& t : *w.map())
-      if (w.get({t.x, t.y}) == tile::free)
-        spawn_candidates.insert(position{t.x, t.y});
-
-  for (position p : spawn_candidates)
-    if (w.get(p) == ::tile::free && rand() < settings.tile_probability)
-    {
-      obstacle o = w.create_obstacle(time_to_move);
-      o.next_move = w.tick() + std::max(1, (int) o.move_distrib(rng));
-
-      assert(o.next_move > w.tick());
-      w.put_obstacle(p, std::move(o));
-    }
+    make_normal(obstacle_settings_.move_probability);
+
+  // Every candidate spawns an obstacle independently with the given
+  // probability, so the gaps between spawning candidates are geometrically
+  // distributed. Drawing the gaps instead of a number for every candidate
+  // makes this cost proportional to the number of hits.
+  bool const always = probability >= 1.0;
+  std::geometric_distribution<std::size_t> gap_distrib(
+    always ? 0.5 : probability
+  );
+  auto gap = [&] () -> std::size_t { return always ? 0 : gap_distrib(rng); };
+
+  std::shared_ptr<std::vector<position> const> const candidates =
+    spawn_candidates();
+
+  for (std::size_t i = gap(); i < candidates->size(); i += 1 + gap()) {
+    position const p = (*candidates)[i];
+    if (get(p) != tile::free)
+      continue;
+
+    obstacle o = create_obstacle(time_to_move);
+    o.next_move = tick_ + std::max(1, (int) o.move_distrib(rng));
+
+    assert(o.next_move > tick_);
+    put_obstacle(p, std::move(o));
+  }
+}
+
+std::shared_ptr<std::vector<position> const>
+world::spawn_candidates() {
+  if (spawn_candidates_)
+    return spawn_candidates_;
+
+  std::vector<position> result;
+  if (obstacle_settings_.spawn_points.empty())
+    map_->foreach_passable([&] (position p) { result.push_back(p); });
+  else {
+    for (position p : obstacle_settings_.spawn_points)
+      if (map_->passable(p))
+        result.push_back(p);
+
+    std::sort(result.begin(), result.end(),
+              [] (position a, position b) {
+                return std::tie(a.y, a.x) < std::tie(b.y, b.x);
+              });
+  }
+
+  spawn_candidates_ =
+    std::make_shared<std::vector<position> const>(std::move(result));
+  return spawn_candidates_;
 }
 
 void
@@ -323,22 +599,60 @@ world::next_tick(std::default_random_engine& rng) {
   ++tick_;
 
   if (obstacle_settings_.mode == obstacle_mode::spawn_to_goal)
-    make_obstacles(*this, obstacle_settings_, rng);
+    spawn_obstacles(rng);
+
+  std::vector<scheduled_move> due;
+  while (!obstacle_schedule_.empty()
+         && obstacle_schedule_.begin()->first <= tick_) {
+    if (obstacle_schedule_.begin()->first == tick_)
+      due = std::move(obstacle_schedule_.begin()->second);
+    obstacle_schedule_.erase(obstacle_schedule_.begin());
+  }
 
-  auto obstacles = obstacles_;
-  for (auto& pos_obst : obstacles) {
-    position const& pos = pos_obst.first;
-    obstacle& obstacle = pos_obst.second;
+  std::size_t remaining = 0;
+  for (scheduled_move const& m : due) {
+    occupancy const& o = occupancy_at(m.where);
+    if (o.tile == tile::obstacle && o.id == m.id
+        && obstacles_.at(m.where).next_move == tick_)
+      ++remaining;
+  }
 
-    if (obstacle.next_move == tick_) {
-      if (obstacle_settings_.mode == obstacle_mode::random)
-        move_random(obstacle, pos, *this, rng);
-      else
-        move_to_goal(obstacle, pos, *this, obstacle_settings_.goal_points, rng);
+  // The moves draw from rng, so they're made in the order of obstacles_, the
+  // same as if every obstacle were checked. The scan stops once all due
+  // obstacles have been found.
+  std::vector<std::pair<position, obstacle>> moving;
+  moving.reserve(remaining);
+  for (auto it = obstacles_.begin(); remaining > 0 && it != obstacles_.end();
+       ++it)
+    if (it->second.next_move == tick_) {
+      moving.push_back(*it);
+      --remaining;
     }
+
+  for (auto const& pos_obstacle : moving) {
+    if (obstacle_settings_.mode == obstacle_mode::random)
+      move_random(pos_obstacle.second, pos_obstacle.first, *this, rng);
+    else
+      move_to_goal(pos_obstacle.second, pos_obstacle.first, *this,
+                   goal_distance(), rng);
   }
 }
 
+std::vector<unsigned> const&
+world::goal_distance() {
+  if (obstacle_settings_.goal_points.empty())
+    throw std::runtime_error{
+      "Move-to-goal mode selected, but no goal points defined"
+    };
+
+  if (!goal_distance_)
+    goal_distance_ = std::make_shared<std::vector<unsigned>>(
+      goal_distances(*map_, obstacle_settings_.goal_points)
+    );
+
+  return *goal_distance_;
+}
+
 boost::optional<agent&>
 world::get_agent(position p) {
   auto const a = agents_.find(p);
@@ -350,9 +664,8 @@ world::get_agent(position p) {
 
 agent const&
 world::get_agent(agent::id_type id) const {
-  for (auto const& pos_agent : agents_)
-    if (std::get<1>(pos_agent).id() == id)
-      return std::get<1>(pos_agent);
+  if (boost::optional<position> p = agent_position(id))
+    return agents_.at(*p);
 
   assert(!"Invalid ID");
   static agent invalid{{}, {}};
@@ -384,6 +697,8 @@ world::put_agent(position p, agent a) {
     throw std::logic_error{"put_agent: Position not empty: " + to_string(p)};
 
   agents_.insert({p, a});
+  occupancy_at(p) = {tile::agent, a.id()};
+  set_directory_entry(agent_positions_, a.id(), p);
 }
 
 void
@@ -391,7 +706,9 @@ world::remove_agent(position p) {
   auto const a = agents_.find(p);
   if (a == agents_.end())
     throw std::logic_error{"remove_agent: Agent not found"};
+  agent_positions_[a->second.id()] = boost::none;
   agents_.erase(a);
+  occupancy_at(p) = {map_->get(p), 0};
 }
 
 void
@@ -399,6 +716,9 @@ world::put_obstacle(position p, obstacle o) {
   if (get(p) != tile::free)
     throw std::logic_error{"put_obstacle: Position not empty"};
   obstacles_.insert({p, o});
+  occupancy_at(p) = {tile::obstacle, o.id()};
+  set_obstacle_position(o.id(), p);
+  schedule(p, o);
 }
 
 void
@@ -406,32 +726,113 @@ world::remove_obstacle(position p) {
   auto const it = obstacles_.find(p);
   if (it == obstacles_.end())
     throw std::logic_error{"remove_obstacle: Obstacle not found"};
+  set_obstacle_position(it->second.id(), boost::none);
   obstacles_.erase(it);
+  occupancy_at(p) = {map_->get(p), 0};
 }
 
-static position
-read_pos(boost::property_tree::ptree const& tree) {
-  if (tree.count("") != 2)
-    throw bad_world_format{"Coordinates must have exactly two components"};
+void
+world::schedule(position p, obstacle const& o) {
+  if (o.next_move > tick_)
+    obstacle_schedule_[o.next_move].push_back({o.id(), p});
+}
 
+void
+world::set_obstacle_position(obstacle::id_type id,
+                             boost::optional<position> p) {
+  if (obstacle_positions_.empty())
+    first_obstacle_id_ = id;
+
+  for (; id < first_obstacle_id_; --first_obstacle_id_)
+    obstacle_positions_.push_front(boost::none);
+
+  if (id - first_obstacle_id_ >= obstacle_positions_.size())
+    obstacle_positions_.resize(id - first_obstacle_id_ + 1);
+  obstacle_positions_[id - first_obstacle_id_] = p;
+
+  // Keep the directory from growing with every obstacle that has ever been.
+  while (!obstacle_positions_.empty() && !obstacle_positions_.front()) {
+    obstacle_positions_.pop_front();
+    ++first_obstacle_id_;
+  }
+  while (!obstacle_positions_.empty() && !obstacle_positions_.back())
+    obstacle_positions_.pop_back();
+}
+
+std::vector<agent_move>
+world::apply(joint_action const& a) {
+  std::vector<agent_move> moves;
+  moves.reserve(a.size());
+
+  // Lift all moving agents off the map first and only then put them down at
+  // their destinations. That way, an agent moving onto a tile that is being
+  // vacated by another agent in the same action doesn't depend on the order in
+  // which the moves are made.
+  std::vector<agent> moving;
+  moving.reserve(a.size());
+
+  a.foreach_action([&] (action act) {
+    auto const it = agents_.find(act.from());
+    if (it == agents_.end())
+      throw std::logic_error{"apply: No agent at " + to_string(act.from())};
+
+    moves.push_back({it->second.id(), act.from(),
+                     translate(act.from(), act.where())});
+    moving.push_back(it->second);
+    remove_agent(act.from());
+  });
+
+  for (std::size_t i = 0; i < moves.size(); ++i)
+    put_agent(moves[i].to, moving[i]);
+
+  return moves;
+}
+
+static position
+read_pos(json_reader& in) {
   position result;
   unsigned i = 0;
-  for (auto const& coord : tree)
-    result[i++] = coord.second.get_value<unsigned>();
+  in.read_array([&] {
+    if (i == 2)
+      in.error("Coordinates must have exactly two components");
+    result[i++] = in.read_unsigned();
+  });
+
+  if (i != 2)
+    in.error("Coordinates must have exactly two components");
 
   return result;
 }
 
-static normal_distribution
-parse_normal(boost::property_tree::ptree const& p) {
-  auto const& params = p.get_child("parameters");
-  if (params.count("") != 2)
-    throw bad_world_format{"Invalid normal distribution parameters"};
+template <typename Set>
+static void
+read_positions(json_reader& in, Set& out) {
+  in.read_array([&] { out.insert(read_pos(in)); });
+}
 
+static normal_distribution
+parse_normal(json_reader& in) {
   std::array<double, 2> distrib_params;
-  auto par = distrib_params.begin();
-  for (auto const& param: params)
-    *par++ = param.second.get_value<double>();
+  bool have_params = false;
+
+  in.read_object([&] (std::string const& key) {
+    if (key == "parameters") {
+      unsigned i = 0;
+      in.read_array([&] {
+        if (i == 2)
+          in.error("Invalid normal distribution parameters");
+        distrib_params[i++] = in.read_double();
+      });
+
+      if (i != 2)
+        in.error("Invalid normal distribution parameters");
+      have_params = true;
+    } else
+      in.skip();
+  });
+
+  if (!have_params)
+    in.error("Missing normal distribution parameters");
 
   return normal_distribution{distrib_params[0], distrib_params[1]};
 }
@@ -458,45 +859,72 @@ obstacle_mode_to_str(obstacle_mode mode) {
 }
 
 static obstacle_settings
-parse_obstacle_settings(boost::property_tree::ptree const& p) {
+parse_obstacle_settings(json_reader& in) {
   obstacle_settings result;
-  result.mode = parse_obstacle_mode(p.get<std::string>("mode"));
-  result.tile_probability = p.get<double>("tile_probability");
-  result.move_probability =
-    parse_normal(p.get_child("obstacle_movement.move_probability"));
-
-  if (p.count("spawn_points"))
-    for (auto point : p.get_child("spawn_points"))
-      result.spawn_points.insert(read_pos(point.second));
+  bool have_mode = false;
+  bool have_tile_probability = false;
+  bool have_move_probability = false;
+
+  in.read_object([&] (std::string const& key) {
+    if (key == "mode") {
+      result.mode = parse_obstacle_mode(in.read_string());
+      have_mode = true;
+    } else if (key == "tile_probability") {
+      result.tile_probability = in.read_double();
+      have_tile_probability = true;
+    } else if (key == "obstacle_movement")
+      in.read_object([&] (std::string const& key) {
+        if (key == "move_probability") {
+          result.move_probability = parse_normal(in);
+          have_move_probability = true;
+        } else
+          in.skip();
+      });
+    else if (key == "spawn_points")
+      read_positions(in, result.spawn_points);
+    else if (key == "goal_points")
+      read_positions(in, result.goal_points);
+    else
+      in.skip();
+  });
 
-  if (p.count("goal_points"))
-    for (auto point : p.get_child("goal_points"))
-      result.goal_points.insert(read_pos(point.second));
+  if (!have_mode)
+    in.error("Missing obstacles.mode");
+  if (!have_tile_probability)
+    in.error("Missing obstacles.tile_probability");
+  if (!have_move_probability)
+    in.error("Missing obstacles.obstacle_movement.move_probability");
 
   return result;
 }
 
 static agent_settings
-parse_agent_settings(boost::property_tree::ptree const& p) {
+parse_agent_settings(json_reader& in) {
   agent_settings result;
-  result.random_agent_number = p.get<unsigned>("random_agents");
-
-  if (auto mode = p.get_child_optional("spawn_mode")) {
-    if (mode->get_value<std::string>() == "uniform")
-      result.spawn_mode = agent_settings::random_spawn_mode::uniform;
-    else if (mode->get_value<std::string>() == "pack")
-      result.spawn_mode = agent_settings::random_spawn_mode::pack;
+  bool have_random_agents = false;
+
+  in.read_object([&] (std::string const& key) {
+    if (key == "random_agents") {
+      result.random_agent_number = in.read_unsigned();
+      have_random_agents = true;
+    } else if (key == "spawn_mode") {
+      std::string const mode = in.read_string();
+      if (mode == "uniform")
+        result.spawn_mode = agent_settings::random_spawn_mode::uniform;
+      else if (mode == "pack")
+        result.spawn_mode = agent_settings::random_spawn_mode::pack;
+      else
+        throw bad_world_format{"Invalid agent spawn mode"};
+    } else if (key == "spawn_points")
+      read_positions(in, result.spawn_points);
+    else if (key == "goal_points")
+      read_positions(in, result.goal_points);
     else
-      throw bad_world_format{"Invalid agent spawn mode"};
-  }
-
-  if (p.count("spawn_points"))
-    for (auto point : p.get_child("spawn_points"))
-      result.spawn_points.insert(read_pos(point.second));
+      in.skip();
+  });
 
-  if (p.count("goal_points"))
-    for (auto point : p.get_child("goal_points"))
-      result.goal_points.insert(read_pos(point.second));
+  if (!have_random_agents)
+    in.error("Missing agent_settings.random_agents");
 
   return result;
 }
@@ -511,20 +939,19 @@ make_candidates(world const& w, agent_settings const& settings) {
       if (w.get(p) == tile::free)
         spawn_candidates.push_back(p);
   } else
-    for (position::coord_type y = 0; y < w.map()->height(); ++y)
-      for (position::coord_type x = 0; x < w.map()->width(); ++x)
-        if (w.get({x, y}) == tile::free)
-          spawn_candidates.push_back({x, y});
+    w.map()->foreach_passable([&] (position p) {
+      if (w.get(p) == tile::free)
+        spawn_candidates.push_back(p);
+    });
 
   if (!settings.goal_points.empty()) {
     for (position p : settings.goal_points)
       if (w.get(p) != tile::wall)
         goal_candidates.push_back(p);
   } else
-    for (position::coord_type y = 0; y < w.map()->height(); ++y)
-      for (position::coord_type x = 0; x < w.map()->width(); ++x)
-        if (w.get({x, y}) != tile::wall)
-          goal_candidates.push_back({x, y});
+    w.map()->foreach_passable([&] (position p) {
+      goal_candidates.push_back(p);
+    });
 
   return {spawn_candidates, goal_candidates};
 }
@@ -636,44 +1063,70 @@ make_agents(world& w, agent_settings settings,
   }
 }
 
-static std::tuple<world, boost::property_tree::ptree>
+// Load the world and report whether the scenario contained agent settings.
+static std::tuple<world, bool>
 load_world_partial(std::string const& filename) try {
-  namespace pt = boost::property_tree;
-  pt::ptree tree;
-  pt::read_json(filename, tree);
-
-  using boost::filesystem::path;
-  using boost::algorithm::trim_copy;
-
-  std::string const map_filename = tree.get<std::string>("map");
-  path const map_path = path{filename}.parent_path() / map_filename;
+  using namespace std::string_literals;
 
-  agent_settings as;
-  if (tree.count("agent_settings"))
-    as = parse_agent_settings(tree.get_child("agent_settings"));
+  std::ifstream file{filename, std::ios::binary};
+  if (!file)
+    throw bad_world_format{"Could not open "s + filename};
 
-  std::shared_ptr<map> m = load_map(map_path.string());
-  obstacle_settings os = parse_obstacle_settings(tree.get_child("obstacles"));
-  world world(std::move(m), std::move(os), as);
+  json_reader in{read_rest(file)};
+
+  boost::optional<std::string> map_filename;
+  boost::optional<obstacle_settings> os;
+  boost::optional<agent_settings> as;
+  std::vector<std::tuple<position, position>> agents;
+
+  in.read_object([&] (std::string const& key) {
+    if (key == "map")
+      map_filename = in.read_string();
+    else if (key == "obstacles")
+      os = parse_obstacle_settings(in);
+    else if (key == "agent_settings")
+      as = parse_agent_settings(in);
+    else if (key == "agents")
+      in.read_array([&] {
+        boost::optional<position> pos;
+        boost::optional<position> goal;
+
+        in.read_object([&] (std::string const& key) {
+          if (key == "position")
+            pos = read_pos(in);
+          else if (key == "goal")
+            goal = read_pos(in);
+          else
+            in.skip();
+        });
+
+        if (!pos)
+          in.error("Missing agent position");
+
+        agents.emplace_back(*pos, goal ? *goal : *pos);
+      });
+    else
+      in.skip();
+  });
+  in.expect_end();
 
-  for (auto const& a : tree.get_child("agents")) {
-    position const pos = read_pos(a.second.get_child("position"));
+  if (!map_filename)
+    throw bad_world_format{"Missing map"};
+  if (!os)
+    throw bad_world_format{"Missing obstacles"};
 
-    boost::optional<position> goal;
-    if (auto const g = a.second.get_child_optional("goal"))
-      goal = read_pos(*g);
+  using boost::filesystem::path;
+  path const map_path = path{filename}.parent_path() / *map_filename;
 
-    if (!goal)
-      goal = pos;
+  std::shared_ptr<map> m = load_map(map_path.string());
+  world world(std::move(m), std::move(*os), as ? *as : agent_settings{});
 
-    world.put_agent(pos, world.create_agent(*goal));
-  }
+  for (auto const& a : agents)
+    world.put_agent(std::get<0>(a), world.create_agent(std::get<1>(a)));
 
-  return std::make_tuple(std::move(world), std::move(tree));
+  return std::make_tuple(std::move(world), bool(as));
 
-} catch (boost::property_tree::json_parser::json_parser_error& e) {
-  throw bad_world_format{e.what()};
-} catch (boost::property_tree::ptree_error& e) {
+} catch (json_error& e) {
   throw bad_world_format{e.what()};
 }
 
@@ -710,136 +1163,122 @@ load_world(std::string const& filename) {
 
 world
 load_world(std::string const& filename, std::default_random_engine& rng) {
-  namespace pt = boost::property_tree;
-
   auto result = load_world_partial(filename);
   world& world = std::get<0>(result);
-  pt::ptree& tree = std::get<1>(result);
 
-  if (auto const obstacles = tree.get_child_optional("obstacles"))
-    make_obstacles(world, parse_obstacle_settings(*obstacles), rng);
+  world.spawn_obstacles(rng);
 
-  if (auto const rand_agents = tree.get_child_optional("agent_settings"))
-    make_agents(world, parse_agent_settings(*rand_agents), rng);
+  if (std::get<1>(result))
+    make_agents(world, world.agent_settings(), rng);
 
   return world;
 }
 
-static boost::property_tree::ptree
-position_to_ptree(position p) {
-  using namespace boost::property_tree;
-
-  ptree x;
-  x.put("", p.x);
-  ptree y;
-  y.put("", p.y);
-
-  ptree result;
-  result.push_back({"", x});
-  result.push_back({"", y});
+static void
+write_pos(json_writer& out, position p) {
+  out.begin_array();
+  out.value(p.x);
+  out.value(p.y);
+  out.end_array();
+}
 
-  return result;
+template <typename Set>
+static void
+write_positions(json_writer& out, Set const& points) {
+  out.begin_array();
+  for (position p : points)
+    write_pos(out, p);
+  out.end_array();
 }
 
 void
 save_world(world const& world, std::string const& filename) {
-  namespace pt = boost::property_tree;
+  using namespace std::string_literals;
+
+  std::ofstream file{filename};
+  if (!file)
+    throw std::runtime_error{"Could not open "s + filename + " for writing"};
 
-  pt::ptree tree;
+  json_writer out{file};
+  out.begin_object();
 
   boost::filesystem::path scenario_path{filename};
   boost::filesystem::path map_path{world.map()->original_filename()};
   boost::filesystem::path relative_map_path =
     make_relative(map_path, scenario_path.parent_path());
-  tree.put("map", relative_map_path.string());
-
-  pt::ptree obstacles;
-  obstacles.add("mode", obstacle_mode_to_str(world.obstacle_settings().mode));
-  obstacles.add("tile_probability", world.obstacle_settings().tile_probability);
-
-  pt::ptree move_probability;
-  move_probability.add("distribution", "normal");
-
-  pt::ptree mean;
-  mean.put("", world.obstacle_settings().move_probability.mean);
-
-  pt::ptree std_dev;
-  std_dev.put("", world.obstacle_settings().move_probability.std_dev);
-
-  pt::ptree parameters;
-  parameters.push_back({"", mean});
-  parameters.push_back({"", std_dev});
-  move_probability.add_child("parameters", parameters);
-
-  pt::ptree obstacle_movement;
-  obstacle_movement.add_child("move_probability", move_probability);
-
-  obstacles.add_child("obstacle_movement", obstacle_movement);
-
-  pt::ptree obstacle_spawn_points;
-  for (position p : world.obstacle_settings().spawn_points)
-    obstacle_spawn_points.push_back({"", position_to_ptree(p)});
-
-  obstacles.add_child("spawn_points", obstacle_spawn_points);
-
-  pt::ptree obstacle_goal_points;
-  for (position p : world.obstacle_settings().goal_points)
-    obstacle_goal_points.push_back({"", position_to_ptree(p)});
-
-  obstacles.add_child("goal_points", obstacle_goal_points);
-
-  tree.add_child("obstacles", obstacles);
-
-  pt::ptree agent_settings;
-
-  pt::ptree rand_agent_num;
-  rand_agent_num.put("", world.agent_settings().random_agent_number);
-  agent_settings.add_child("random_agents", rand_agent_num);
-
-  pt::ptree rand_agent_mode;
-  switch (world.agent_settings().spawn_mode) {
+  out.key("map");
+  out.value(relative_map_path.string());
+
+  ::obstacle_settings const& obstacles = world.obstacle_settings();
+  out.key("obstacles");
+  out.begin_object();
+  out.key("mode");
+  out.value(obstacle_mode_to_str(obstacles.mode));
+  out.key("tile_probability");
+  out.value(obstacles.tile_probability);
+
+  out.key("obstacle_movement");
+  out.begin_object();
+  out.key("move_probability");
+  out.begin_object();
+  out.key("distribution");
+  out.value("normal");
+  out.key("parameters");
+  out.begin_array();
+  out.value(obstacles.move_probability.mean);
+  out.value(obstacles.move_probability.std_dev);
+  out.end_array();
+  out.end_object();
+  out.end_object();
+
+  out.key("spawn_points");
+  write_positions(out, obstacles.spawn_points);
+  out.key("goal_points");
+  write_positions(out, obstacles.goal_points);
+  out.end_object();
+
+  ::agent_settings const& agents = world.agent_settings();
+  out.key("agent_settings");
+  out.begin_object();
+  out.key("random_agents");
+  out.value(agents.random_agent_number);
+
+  out.key("spawn_mode");
+  switch (agents.spawn_mode) {
   case agent_settings::random_spawn_mode::uniform:
-    rand_agent_mode.put("", "uniform");
+    out.value("uniform");
     break;
 
   case agent_settings::random_spawn_mode::pack:
-    rand_agent_mode.put("", "pack");
+    out.value("pack");
     break;
   }
 
-  agent_settings.add_child("spawn_mode", rand_agent_mode);
-
-  if (!world.agent_settings().spawn_points.empty()) {
-    pt::ptree points;
-    for (position p : world.agent_settings().spawn_points)
-      points.push_back({"", position_to_ptree(p)});
-
-    agent_settings.add_child("spawn_points", points);
+  if (!agents.spawn_points.empty()) {
+    out.key("spawn_points");
+    write_positions(out, agents.spawn_points);
   }
 
-  if (!world.agent_settings().goal_points.empty()) {
-    pt::ptree points;
-    for (position p : world.agent_settings().goal_points)
-      points.push_back({"", position_to_ptree(p)});
-
-    agent_settings.add_child("goal_points", points);
+  if (!agents.goal_points.empty()) {
+    out.key("goal_points");
+    write_positions(out, agents.goal_points);
   }
+  out.end_object();
 
-  tree.add_child("agent_settings", agent_settings);
-
-  pt::ptree agents;
+  out.key("agents");
+  out.begin_array();
   for (auto pos_agent : world.agents()) {
-    position const pos = std::get<0>(pos_agent);
-    agent const a = std::get<1>(pos_agent);
-
-    pt::ptree agent_tree;
-    agent_tree.add_child("position", position_to_ptree(pos));
-    agent_tree.add_child("goal", position_to_ptree(a.target));
-
-    agents.push_back({"", agent_tree});
+    out.begin_object();
+    out.key("position");
+    write_pos(out, std::get<0>(pos_agent));
+    out.key("goal");
+    write_pos(out, std::get<1>(pos_agent).target);
+    out.end_object();
   }
+  out.end_array();
 
-  tree.add_child("agents", agents);
+  out.end_object();
 
-  pt::write_json(filename, tree);
+  if (!file.flush())
+    throw std::runtime_error{"Could not write "s + filename};
 }
@@ -6,10 +6,15 @@
 #include <boost/functional/hash.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/optional.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <array>
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <map>
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -207,12 +212,26 @@ public:
     distance_to(iterator other) const { return other.i_ - i_; }
   };
 
+  // Word of the passability bitboard.
+  using word_type = std::uint64_t;
+  static constexpr coord_type word_bits = 64;
+
   map(coord_type width, coord_type height, std::string const& filename)
     : tiles_(width * height, tile::free)
     , width_{width}
     , height_{height}
+    , words_per_row_{(width + word_bits - 1) / word_bits}
+    , passable_(words_per_row_ * height)
     , filename_{filename}
-  { }
+  {
+    for (coord_type y = 0; y < height; ++y)
+      for (coord_type x = 0; x < width; ++x)
+        set_passable(x, y, true);
+  }
+
+  // Make a map from row-major tiles. The adjacency graph is built right away.
+  map(coord_type width, coord_type height, std::vector<tile> tiles,
+      std::string const& filename);
 
   tile
   get(coord_type x, coord_type y) const { return tiles_[y * width_ + x]; }
@@ -223,9 +242,13 @@ public:
   coord_type width() const  { return width_; }
   coord_type height() const { return height_; }
 
+  // Change a tile. This makes the adjacency graph stale until
+  // build_adjacency is called.
   void
   put(coord_type x, coord_type y, tile t) {
     tiles_[y * width_ + x] = t;
+    set_passable(x, y, t != tile::wall);
+    adjacency_stale_ = true;
   }
 
   void
@@ -233,6 +256,55 @@ public:
     put(p.x, p.y, t);
   }
 
+  // Is the given position within bounds and not a wall?
+  bool
+  passable(coord_type x, coord_type y) const {
+    return x >= 0 && y >= 0 && x < width_ && y < height_
+        && (passable_[y * words_per_row_ + x / word_bits] >> (x % word_bits))
+           & 1;
+  }
+
+  bool
+  passable(position p) const { return passable(p.x, p.y); }
+
+  // Passable 4-neighbourhood of a tile. Bit d of the result is set if the
+  // neighbour in direction d is passable, with the bits numbered by the
+  // values of the direction enum.
+  unsigned
+  passable_neighbours(position p) const;
+
+  // Passability bits of row y: words_per_row() words, the bit for tile x
+  // being bit x % word_bits of word x / word_bits. Padding bits are zero.
+  word_type const*
+  passable_row(coord_type y) const {
+    return passable_.data() + y * words_per_row_;
+  }
+
+  coord_type words_per_row() const { return words_per_row_; }
+
+  using adjacency_range = boost::iterator_range<position const*>;
+
+  // Passable neighbours of a tile, in the order of all_directions. This is
+  // looked up in a precomputed compressed adjacency graph, so it neither
+  // allocates nor tests any tiles. Walls have no neighbours.
+  adjacency_range
+  adjacent(position p) const {
+    assert(!adjacency_stale_);
+    std::size_t const i = p.y * width_ + p.x;
+    return {adjacency_.data() + adjacency_offsets_[i],
+            adjacency_.data() + adjacency_offsets_[i + 1]};
+  }
+
+  // (Re)build the adjacency graph from the current tiles. This has to be
+  // called after the map has been filled.
+  void
+  build_adjacency();
+
+  // Call f(position) for every passable tile in row-major order.
+  template <typename F>
+  void
+  foreach_passable(F&& f) const;
+
   iterator begin() const { return {this, 0}; }
   iterator end() const   { return {this, width_ * height_}; }
 
@@ -242,13 +314,64 @@ public:
 private:
   std::vector<tile> tiles_;
   coord_type width_, height_;
+  coord_type words_per_row_;
+  std::vector<word_type> passable_;
+  std::vector<unsigned> adjacency_offsets_;  // Index into adjacency_ per tile.
+  std::vector<position> adjacency_;
+  bool adjacency_stale_ = true;
   std::string filename_;
+
+  void
+  set_passable(coord_type x, coord_type y, bool value) {
+    word_type& word = passable_[y * words_per_row_ + x / word_bits];
+    word_type const bit = word_type{1} << (x % word_bits);
+    if (value)
+      word |= bit;
+    else
+      word &= ~bit;
+  }
 };
 
-// Load a map from a file.
+inline unsigned
+map::passable_neighbours(position p) const {
+  unsigned result = 0;
+  if (passable(p.x, p.y - 1)) result |= 1u << (unsigned) direction::north;
+  if (passable(p.x + 1, p.y)) result |= 1u << (unsigned) direction::east;
+  if (passable(p.x, p.y + 1)) result |= 1u << (unsigned) direction::south;
+  if (passable(p.x - 1, p.y)) result |= 1u << (unsigned) direction::west;
+  return result;
+}
+
+template <typename F>
+void
+map::foreach_passable(F&& f) const {
+  for (coord_type y = 0; y < height_; ++y) {
+    word_type const* row = passable_row(y);
+    for (coord_type w = 0; w < words_per_row_; ++w)
+      for (word_type bits = row[w]; bits; bits &= bits - 1)
+        f(position{w * word_bits + __builtin_ctzll(bits), y});
+  }
+}
+
+// Load a map from a file. If there is an up-to-date binary cache of the map
+// next to the file, the cache is read instead.
 std::shared_ptr<map>
 load_map(std::string const& filename);
 
+// Name of the binary cache for the given map file.
+std::string
+map_cache_filename(std::string const& map_filename);
+
+// Is there a binary cache for the map file that is newer than the file itself?
+bool
+map_cache_current(std::string const& map_filename);
+
+// Write the binary cache for the map, next to its original file. The cache
+// stores the walls as a bitboard and is read by load_map much faster than the
+// text format.
+void
+save_map_cache(map const&);
+
 // Is a given position within the bounds of the map?
 bool in_bounds(position p, map const& m);
 bool in_bounds(int x, int y, map const& m);
@@ -301,6 +424,15 @@ enum class obstacle_mode {
   spawn_to_goal
 };
 
+// Change of position of a single agent, as reported by world::apply.
+struct agent_move {
+  ::agent::id_type agent;
+  position from;
+  position to;
+};
+
+class joint_action;
+
 // Scenario settings for obstacles.
 struct obstacle_settings {
   obstacle_mode mode;
@@ -341,8 +473,14 @@ public:
   void
   next_tick(std::default_random_engine&);
 
+  // Place an obstacle on each free spawn tile with the probability given by
+  // the obstacle settings. Takes time proportional to the number of obstacles
+  // placed, not to the number of spawn tiles.
+  void
+  spawn_obstacles(std::default_random_engine&);
+
   // Get the tile at the given position. Unlike map::get, this also reports
-  // agents and obstacles.
+  // agents and obstacles. Positions outside the map are reported as walls.
   tile
   get(position) const;
 
@@ -357,6 +495,38 @@ public:
   agent const&
   get_agent(agent::id_type) const;
 
+  using id_directory = std::vector<boost::optional<position>>;
+  using obstacle_directory = std::deque<boost::optional<position>>;
+
+  // Position of each agent, indexed by ID. Entries are empty for IDs not
+  // currently in the world.
+  id_directory const&
+  agent_positions() const { return agent_positions_; }
+
+  // Position of each obstacle, indexed by ID less obstacle_id_begin(). Entries
+  // are empty for IDs not currently in the world. Obstacles keep coming and
+  // going in some modes and their IDs aren't reused, so the directory only
+  // spans the IDs from the lowest to the highest one present.
+  obstacle_directory const&
+  obstacle_positions() const { return obstacle_positions_; }
+
+  obstacle::id_type
+  obstacle_id_begin() const { return first_obstacle_id_; }
+
+  boost::optional<position>
+  agent_position(agent::id_type id) const {
+    return id < agent_positions_.size() ? agent_positions_[id]
+                                        : boost::optional<position>{};
+  }
+
+  boost::optional<position>
+  obstacle_position(obstacle::id_type id) const {
+    return id >= first_obstacle_id_
+           && id - first_obstacle_id_ < obstacle_positions_.size()
+      ? obstacle_positions_[id - first_obstacle_id_]
+      : boost::optional<position>{};
+  }
+
   // Make a new agent with the given goal. The agent is not placed in the world
   // -- for that, put_agent has to be called.
   agent
@@ -383,6 +553,12 @@ public:
   void
   remove_obstacle(position p);  // Throws std::logic_error if p empty
 
+  // Apply the joint action in place. Only the agents that move are touched, so
+  // this costs time proportional to the size of the action. The action has to
+  // be valid for this world. Returns the moves that were made.
+  std::vector<agent_move>
+  apply(joint_action const&);
+
   // The underlying map.
   std::shared_ptr<::map const>
   map() const { return map_; }
@@ -396,8 +572,14 @@ public:
   obstacle_list const&
   obstacles() const { return obstacles_; }
 
+  // Obstacle settings may be changed through the returned reference until the
+  // next tick; the data derived from them is then recomputed.
   ::obstacle_settings&
-  obstacle_settings() { return obstacle_settings_; }
+  obstacle_settings() {
+    goal_distance_.reset();
+    spawn_candidates_.reset();
+    return obstacle_settings_;
+  }
 
   ::obstacle_settings const&
   obstacle_settings() const { return obstacle_settings_; }
@@ -409,24 +591,70 @@ public:
   agent_settings() const { return agent_settings_; }
 
 private:
+  // Contents of a single tile: the static map tile overlaid with whatever agent
+  // or obstacle stands on it. For agents and obstacles, id is the agent's or
+  // obstacle's ID.
+  struct occupancy {
+    ::tile tile;
+    unsigned id;
+  };
+
   std::shared_ptr<::map const> map_;
   agents_list agents_;
   obstacle_list obstacles_;
+  std::vector<occupancy> occupancy_;  // Kept in sync with the above.
+  id_directory agent_positions_;      // Likewise.
+  obstacle_directory obstacle_positions_;  // Likewise.
+  obstacle::id_type first_obstacle_id_ = 0;
+
+  // An obstacle waiting for its next move. The entry becomes stale if the
+  // obstacle is removed before that; stale entries are ignored when their tick
+  // comes.
+  struct scheduled_move {
+    obstacle::id_type id;
+    position where;
+  };
+
+  // Obstacles waiting to move, bucketed by obstacle::next_move.
+  std::map<tick_t, std::vector<scheduled_move>> obstacle_schedule_;
   tick_t tick_{};
   ::obstacle_settings obstacle_settings_;
   ::agent_settings agent_settings_;
+
+  // For spawn_to_goal obstacles: distance of each tile to the nearest goal
+  // point, or unreachable. Shared between copies of the world; null if it
+  // needs to be recomputed.
+  std::shared_ptr<std::vector<unsigned> const> goal_distance_;
+
+  // Passable tiles obstacles may spawn on, in row-major order. Shared and
+  // recomputed the same way as goal_distance_.
+  std::shared_ptr<std::vector<position> const> spawn_candidates_;
+
   agent::id_type next_agent_id_ = 0;
   obstacle::id_type next_obstacle_id_ = 0;
+
+  occupancy&
+  occupancy_at(position p) { return occupancy_[p.y * map_->width() + p.x]; }
+
+  void
+  schedule(position, obstacle const&);
+
+  void
+  set_obstacle_position(obstacle::id_type, boost::optional<position>);
+
+  std::vector<unsigned> const&
+  goal_distance();
+
+  std::shared_ptr<std::vector<position> const>
+  spawn_candidates();
 };
 
 inline tile
 world::get(position p) const {
-  if (agents_.count(p))
-    return tile::agent;
-  else if (obstacles_.count(p))
-    return tile::obstacle;
-  else
-    return map_->get(p);
+  if (p.x < 0 || p.y < 0 || p.x >= map_->width() || p.y >= map_->height())
+    return tile::wall;
+
+  return occupancy_[p.y * map_->width() + p.x].tile;
 }
 
 struct bad_world_format : std::runtime_error {